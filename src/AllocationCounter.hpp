@@ -0,0 +1,245 @@
+/*
+ * AllocationCounter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef ALLOCATIONCOUNTER_HPP_
+#define ALLOCATIONCOUNTER_HPP_
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <new>
+#include <string>
+#include "Stopwatch.hpp"
+using namespace std;
+
+//!
+//!  Counts the heap allocations made by each thread. Exactly one translation unit of a program
+//!  defines PUTILS_COUNT_ALLOCATIONS before including this header; it then replaces malloc, calloc,
+//!  realloc, posix_memalign, aligned_alloc, memalign, free and the global operator new and delete
+//!  with versions which count and forward to the C library. Without it the counts stay at zero and allocationCountingEnabled() is false.
+//!
+
+namespace putils {
+
+//!
+//! \brief heap calls made by one thread
+//!
+struct AllocationCounts {
+    size_t allocations;
+    size_t frees;
+    size_t bytes;
+};
+
+//!
+//! \brief the running counts of the calling thread
+//!
+inline AllocationCounts& threadAllocationCounts() throw ()
+{
+    static __thread AllocationCounts counts = { 0, 0, 0 };
+    return counts;
+}
+
+inline bool& allocationCountingFlag() throw ()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+//!
+//! \brief true when the counting hooks are linked into the program
+//!
+inline bool allocationCountingEnabled() throw ()
+{
+    return allocationCountingFlag();
+}
+
+//!
+//! \brief the allocations made by the calling thread since construction (or restart)
+//!
+class AllocationScope {
+public:
+    AllocationScope() throw ()
+    {
+        restart();
+    };
+
+    void restart() throw ()
+    {
+        start = threadAllocationCounts();
+    };
+
+    size_t allocations() const throw ()
+    {
+        return threadAllocationCounts().allocations-start.allocations;
+    };
+
+    size_t frees() const throw ()
+    {
+        return threadAllocationCounts().frees-start.frees;
+    };
+
+    size_t bytes() const throw ()
+    {
+        return threadAllocationCounts().bytes-start.bytes;
+    };
+
+private:
+    AllocationCounts start;
+};
+
+//!
+//! \brief the number of allocation checks which have failed so far, for a driver's exit status
+//!
+inline size_t& allocationCheckFailures() throw ()
+{
+    static size_t failures = 0;
+    return failures;
+}
+
+//!
+//! \brief run op reps times, print the allocations and time per call and check that no single
+//!  call allocated more than max_per_call times. Returns false, and counts a failure, if the bound
+//!  is exceeded.
+//!
+template<class Op>
+bool checkAllocations(const char *name,size_t max_per_call,size_t reps,Op op)
+{
+    op();
+    AllocationScope total;
+    AllocationScope call;
+    size_t worst = 0;
+    Stopwatch sw;
+    sw.start();
+    for (size_t k=0; k<reps; ++k) {
+        call.restart();
+        op();
+        size_t n = call.allocations();
+        if (n>worst) worst = n;
+    }
+    sw.stop();
+    size_t n = total.allocations();
+    bool ok = worst<=max_per_call;
+    fprintf(stderr,"%-40s %8.3f allocations %4zu at most %10.1f ns per call%s\n",name,double(n)/reps,
+            worst,1.e9*sw.elapsedTime()/reps,(ok) ? "":"  FAILED");
+    if (!ok) ++allocationCheckFailures();
+    return ok;
+}
+
+}
+
+#ifdef PUTILS_COUNT_ALLOCATIONS
+extern "C" {
+    void *__libc_malloc(size_t);
+    void *__libc_calloc(size_t,size_t);
+    void *__libc_realloc(void*,size_t);
+    void *__libc_memalign(size_t,size_t);
+    void __libc_free(void*);
+
+    void *malloc(size_t n)
+    {
+        putils::AllocationCounts& c = putils::threadAllocationCounts();
+        ++c.allocations;
+        c.bytes += n;
+        return __libc_malloc(n);
+    }
+
+    void *calloc(size_t m,size_t n)
+    {
+        putils::AllocationCounts& c = putils::threadAllocationCounts();
+        ++c.allocations;
+        c.bytes += m*n;
+        return __libc_calloc(m,n);
+    }
+
+    void *realloc(void *p,size_t n)
+    {
+        putils::AllocationCounts& c = putils::threadAllocationCounts();
+        ++c.allocations;
+        c.bytes += n;
+        return __libc_realloc(p,n);
+    }
+
+    void *memalign(size_t alignment,size_t n) throw ()
+    {
+        putils::AllocationCounts& c = putils::threadAllocationCounts();
+        ++c.allocations;
+        c.bytes += n;
+        return __libc_memalign(alignment,n);
+    }
+
+    void *aligned_alloc(size_t alignment,size_t n) throw ()
+    {
+        return memalign(alignment,n);
+    }
+
+    int posix_memalign(void **p,size_t alignment,size_t n) throw ()
+    {
+        if (alignment<sizeof(void*) || (alignment&(alignment-1))) return EINVAL;
+        void *q = memalign(alignment,n);
+        if (!q) return ENOMEM;
+        *p = q;
+        return 0;
+    }
+
+    void free(void *p)
+    {
+        if (p) ++putils::threadAllocationCounts().frees;
+        __libc_free(p);
+    }
+}
+
+void *operator new(size_t n)
+{
+    void *p = malloc((n) ? n:1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t n)
+{
+    return operator new(n);
+}
+
+void *operator new(size_t n,const std::nothrow_t&) throw ()
+{
+    return malloc((n) ? n:1);
+}
+
+void *operator new[](size_t n,const std::nothrow_t&) throw ()
+{
+    return malloc((n) ? n:1);
+}
+
+void operator delete(void *p) throw ()
+{
+    free(p);
+}
+
+void operator delete[](void *p) throw ()
+{
+    free(p);
+}
+
+void operator delete(void *p,size_t) throw ()
+{
+    free(p);
+}
+
+void operator delete[](void *p,size_t) throw ()
+{
+    free(p);
+}
+
+namespace {
+struct AllocationCountingInit {
+    AllocationCountingInit()
+    {
+        putils::allocationCountingFlag() = true;
+    };
+} allocation_counting_init;
+}
+#endif
+
+#endif /* ALLOCATIONCOUNTER_HPP_ */
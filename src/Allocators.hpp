@@ -0,0 +1,512 @@
+/*
+ * Allocators.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef ALLOCATORS_HPP_
+#define ALLOCATORS_HPP_
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+extern "C" {
+#include <sys/mman.h>
+}
+#include <unistd.h>
+#include "putils.hpp"
+using namespace std;
+
+#define PUTILS_CACHE_LINE 64
+#define PUTILS_HUGE_PAGE (2UL*1024UL*1024UL)
+
+namespace putils {
+
+//!
+//! \brief running counters for one family of allocations. Safe to update from any thread.
+//!
+struct AllocStats {
+    atomic<size_t> allocs;
+    atomic<size_t> frees;
+    atomic<size_t> bytes_in_use;
+    atomic<size_t> peak_bytes;
+
+    AllocStats():allocs(0),frees(0),bytes_in_use(0),peak_bytes(0) {};
+
+    void recordAlloc(size_t nbytes) throw()
+    {
+        allocs.fetch_add(1,memory_order_relaxed);
+        size_t now = bytes_in_use.fetch_add(nbytes,memory_order_relaxed) + nbytes;
+        size_t peak = peak_bytes.load(memory_order_relaxed);
+        while (now>peak && !peak_bytes.compare_exchange_weak(peak,now,memory_order_relaxed)) {}
+    };
+
+    void recordFree(size_t nbytes) throw()
+    {
+        frees.fetch_add(1,memory_order_relaxed);
+        bytes_in_use.fetch_sub(nbytes,memory_order_relaxed);
+    };
+
+    void clear() throw()
+    {
+        allocs = 0;
+        frees = 0;
+        bytes_in_use = 0;
+        peak_bytes = 0;
+    };
+
+    ostream& write2Stream(ostream& os) const
+    {
+        os << "allocs = " << allocs.load() << " frees = " << frees.load();
+        os << " bytes in use = " << bytes_in_use.load() << " peak bytes = " << peak_bytes.load() << "\n";
+        return os;
+    };
+};
+
+enum AllocKind { ALIGNED_ALLOC=0, HUGE_PAGE_ALLOC, POOL_ALLOC, ARENA_ALLOC, NUM_ALLOC_KINDS };
+
+//!
+//! \brief return the statistics kept for the given allocation family
+//!
+inline AllocStats& allocStats(AllocKind kind)
+{
+    static AllocStats stats[NUM_ALLOC_KINDS];
+    return stats[kind];
+}
+
+//!
+//! \brief write the statistics of every allocation family to the stream
+//!
+inline ostream& writeAllocStats(ostream& os)
+{
+    static const char *names[NUM_ALLOC_KINDS] = { "aligned", "huge page", "pool", "arena" };
+    for (int k=0; k<NUM_ALLOC_KINDS; ++k) {
+        os << setw(10) << names[k] << " : ";
+        allocStats(AllocKind(k)).write2Stream(os);
+    }
+    return os;
+}
+
+inline bool isPowerOfTwo(size_t n) throw()
+{
+    return n && !(n&(n-1));
+}
+
+//!
+//! \brief allocate nbytes aligned on the given power of two boundary. Throws bad_alloc on failure,
+//!  and PutilsError if alignment is not a power of two; allocators use this.
+//!
+inline void *AlignedAllocate(size_t nbytes,size_t alignment=PUTILS_CACHE_LINE)
+{
+    if (!isPowerOfTwo(alignment)) {
+        throw PutilsError(string("AlignedAllocate alignment ")+type2string(alignment)+" is not a power of two");
+    }
+    void *ptr = 0;
+    if (alignment<sizeof(void*)) alignment = sizeof(void*);
+    if (posix_memalign(&ptr,alignment,nbytes?nbytes:1)) throw bad_alloc();
+    allocStats(ALIGNED_ALLOC).recordAlloc(nbytes);
+    return ptr;
+}
+
+//!
+//! \brief allocate nbytes aligned on the given power of two boundary. Exits on failure like Malloc.
+//!
+inline void *AlignedMalloc(size_t nbytes,size_t alignment=PUTILS_CACHE_LINE)
+{
+    if (!isPowerOfTwo(alignment)) {
+        fprintf(stderr,"AlignedMalloc alignment %lu is not a power of two\n",alignment);
+        exit(EXIT_FAILURE);
+    }
+    void *ptr = 0;
+    if (alignment<sizeof(void*)) alignment = sizeof(void*);
+    if (posix_memalign(&ptr,alignment,nbytes?nbytes:1)==0) {
+        allocStats(ALIGNED_ALLOC).recordAlloc(nbytes);
+        return ptr;
+    }
+    fprintf(stderr,"AlignedMalloc failed to allocate %lu bytes\n",nbytes);
+    exit(EXIT_FAILURE);
+}
+
+inline void AlignedFree(void *ptr,size_t nbytes)
+{
+    if (!ptr) return;
+    allocStats(ALIGNED_ALLOC).recordFree(nbytes);
+    free(ptr);
+}
+
+//!
+//! \brief allocate nbytes backed by huge pages.
+//!
+//!  MAP_HUGETLB is tried first. If no huge pages are reserved the memory is mapped normally and
+//!  transparent huge pages are requested with madvise. The size is rounded up to whole huge pages
+//!  and the same nbytes must be passed to HugePageFree.
+//!
+inline void *HugePageMalloc(size_t nbytes)
+{
+    size_t len = (nbytes+PUTILS_HUGE_PAGE-1) & ~(PUTILS_HUGE_PAGE-1);
+    if (len==0) len = PUTILS_HUGE_PAGE;
+    void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    ptr = mmap(0,len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+#endif
+    if (ptr==MAP_FAILED) {
+        ptr = mmap(0,len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+        if (ptr==MAP_FAILED) {
+            fprintf(stderr,"HugePageMalloc failed to allocate %lu bytes\n",nbytes);
+            exit(EXIT_FAILURE);
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(ptr,len,MADV_HUGEPAGE);
+#endif
+    }
+    allocStats(HUGE_PAGE_ALLOC).recordAlloc(len);
+    return ptr;
+}
+
+inline void HugePageFree(void *ptr,size_t nbytes)
+{
+    if (!ptr) return;
+    size_t len = (nbytes+PUTILS_HUGE_PAGE-1) & ~(PUTILS_HUGE_PAGE-1);
+    if (len==0) len = PUTILS_HUGE_PAGE;
+    allocStats(HUGE_PAGE_ALLOC).recordFree(len);
+    munmap(ptr,len);
+}
+
+//!
+//! \brief per thread free lists of small blocks in 16 byte size classes up to MAX_SIZE bytes.
+//!
+//!  Blocks are carved from cache line aligned chunks. A block may be freed on any thread, it goes
+//!  on that thread's free list. When a thread exits its free lists are handed to a shared depot
+//!  which new threads draw from before carving new chunks. Chunks are never returned to the system.
+//!  Failures throw bad_alloc.
+//!
+//!  The pool statistics are shared counters, so they are only kept when PUTILS_POOL_STATS is
+//!  defined; otherwise the fast path touches nothing outside the thread.
+//!
+class SizeClassPool {
+public:
+    enum { GRANULE = 16, MAX_SIZE = 1024, NUM_CLASSES = MAX_SIZE/GRANULE, CHUNK_SIZE = 64*1024 };
+
+    static void *allocate(size_t nbytes)
+    {
+        if (nbytes>MAX_SIZE) {
+            void *ptr = malloc(nbytes);
+            if (!ptr) throw bad_alloc();
+            return ptr;
+        }
+        size_t c = sizeClass(nbytes);
+        SizeClassPool& pool = local();
+        Block *b = pool.heads[c];
+        if (!b) b = pool.refill(c);
+        pool.heads[c] = b->next;
+#ifdef PUTILS_POOL_STATS
+        allocStats(POOL_ALLOC).recordAlloc((c+1)*GRANULE);
+#endif
+        return b;
+    };
+
+    //!
+    //! \brief return a block to the pool. nbytes must be the size passed to allocate.
+    //!
+    static void deallocate(void *ptr,size_t nbytes)
+    {
+        if (!ptr) return;
+        if (nbytes>MAX_SIZE) {
+            free(ptr);
+            return;
+        }
+        size_t c = sizeClass(nbytes);
+        SizeClassPool& pool = local();
+        Block *b = static_cast<Block*>(ptr);
+        b->next = pool.heads[c];
+        pool.heads[c] = b;
+#ifdef PUTILS_POOL_STATS
+        allocStats(POOL_ALLOC).recordFree((c+1)*GRANULE);
+#endif
+    };
+
+    ~SizeClassPool()
+    {
+        Depot& d = depot();
+        lock_guard<mutex> lock(d.mtx);
+        for (size_t c=0; c<NUM_CLASSES; ++c) {
+            while (heads[c]) {
+                Block *b = heads[c];
+                heads[c] = b->next;
+                b->next = d.heads[c];
+                d.heads[c] = b;
+            }
+        }
+    };
+
+private:
+    struct Block {
+        Block *next;
+    };
+    struct Depot {
+        mutex mtx;
+        Block *heads[NUM_CLASSES];
+        Depot()
+        {
+            memset(heads,0,sizeof(heads));
+        };
+    };
+
+    Block *heads[NUM_CLASSES];
+
+    SizeClassPool()
+    {
+        memset(heads,0,sizeof(heads));
+    };
+
+    static size_t sizeClass(size_t nbytes) throw()
+    {
+        return (nbytes) ? (nbytes-1)/GRANULE:0;
+    };
+
+    static SizeClassPool& local()
+    {
+        static thread_local SizeClassPool pool;
+        return pool;
+    };
+
+    static Depot& depot()
+    {
+        static Depot d;
+        return d;
+    };
+
+    Block *refill(size_t c)
+    {
+        {
+            Depot& d = depot();
+            lock_guard<mutex> lock(d.mtx);
+            if (d.heads[c]) {
+                heads[c] = d.heads[c];
+                d.heads[c] = 0;
+                return heads[c];
+            }
+        }
+        size_t bsize = (c+1)*GRANULE;
+        char *chunk = static_cast<char*>(AlignedAllocate(CHUNK_SIZE,PUTILS_CACHE_LINE));
+        size_t nblocks = CHUNK_SIZE/bsize;
+        for (size_t k=0; k<nblocks; ++k) {
+            Block *b = reinterpret_cast<Block*>(chunk+k*bsize);
+            b->next = heads[c];
+            heads[c] = b;
+        }
+        return heads[c];
+    };
+};
+
+inline void *PoolMalloc(size_t nbytes)
+{
+    return SizeClassPool::allocate(nbytes);
+}
+
+inline void PoolFree(void *ptr,size_t nbytes)
+{
+    SizeClassPool::deallocate(ptr,nbytes);
+}
+
+//!
+//! \brief a bump allocator. Individual allocations are never freed, the whole arena is reset at once.
+//!
+//!  Memory comes in blocks of at least block_size bytes. reset keeps the first block for reuse and
+//!  returns the others. Alignments must be powers of two. A failure to get a block throws
+//!  bad_alloc. An Arena is not thread safe.
+//!
+class Arena {
+public:
+    Arena(size_t block_size_in=256*1024):block_size(block_size_in),cur(0),end(0),used(0)
+    {
+    };
+
+    virtual ~Arena()
+    {
+        release();
+    };
+
+    void *allocate(size_t nbytes,size_t alignment=sizeof(void*))
+    {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cur)+alignment-1) & ~(uintptr_t(alignment)-1);
+        if (!cur || p+nbytes>reinterpret_cast<uintptr_t>(end)) {
+            newBlock(nbytes+alignment);
+            p = (reinterpret_cast<uintptr_t>(cur)+alignment-1) & ~(uintptr_t(alignment)-1);
+        }
+        cur = reinterpret_cast<char*>(p+nbytes);
+        used += nbytes;
+        return reinterpret_cast<void*>(p);
+    };
+
+    //!
+    //! \brief discard every allocation made from the arena
+    //!
+    void reset()
+    {
+        if (blocks.empty()) return;
+        for (size_t k=1; k<blocks.size(); ++k) {
+            AlignedFree(blocks[k].first,blocks[k].second);
+            allocStats(ARENA_ALLOC).recordFree(blocks[k].second);
+        }
+        blocks.resize(1);
+        cur = static_cast<char*>(blocks[0].first);
+        end = cur+blocks[0].second;
+        used = 0;
+    };
+
+    //!
+    //! \brief discard every allocation and return all memory
+    //!
+    void release()
+    {
+        for (size_t k=0; k<blocks.size(); ++k) {
+            AlignedFree(blocks[k].first,blocks[k].second);
+            allocStats(ARENA_ALLOC).recordFree(blocks[k].second);
+        }
+        blocks.clear();
+        cur = end = 0;
+        used = 0;
+    };
+
+    size_t bytesUsed() const throw()
+    {
+        return used;
+    };
+
+    size_t bytesReserved() const throw()
+    {
+        size_t n = 0;
+        for (size_t k=0; k<blocks.size(); ++k) n += blocks[k].second;
+        return n;
+    };
+
+private:
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+
+    size_t block_size;
+    char *cur;
+    char *end;
+    size_t used;
+    vector< pair<void*,size_t> > blocks;
+
+    void newBlock(size_t min_size)
+    {
+        size_t n = (min_size>block_size) ? min_size:block_size;
+        void *b = AlignedAllocate(n,PUTILS_CACHE_LINE);
+        allocStats(ARENA_ALLOC).recordAlloc(n);
+        blocks.push_back(make_pair(b,n));
+        cur = static_cast<char*>(b);
+        end = cur+n;
+    };
+};
+
+//!
+//! \brief std compatible allocator returning memory aligned on Alignment bytes
+//!
+template < class T, size_t Alignment = PUTILS_CACHE_LINE > struct AlignedAllocator {
+    static_assert(Alignment && !(Alignment&(Alignment-1)),"the alignment must be a power of two");
+    typedef T value_type;
+    template < class U > struct rebind {
+        typedef AlignedAllocator<U,Alignment> other;
+    };
+
+    AlignedAllocator() throw() {};
+    template < class U > AlignedAllocator(const AlignedAllocator<U,Alignment>&) throw() {};
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T*>(AlignedAllocate(n*sizeof(T),Alignment));
+    };
+
+    void deallocate(T *ptr,size_t n)
+    {
+        AlignedFree(ptr,n*sizeof(T));
+    };
+};
+
+template < class T, class U, size_t A > inline bool operator==(const AlignedAllocator<T,A>&,const AlignedAllocator<U,A>&)
+{
+    return true;
+}
+template < class T, class U, size_t A > inline bool operator!=(const AlignedAllocator<T,A>&,const AlignedAllocator<U,A>&)
+{
+    return false;
+}
+
+//!
+//! \brief std compatible allocator drawing small requests from the per thread size class pools
+//!
+template < class T > struct PoolAllocator {
+    typedef T value_type;
+    template < class U > struct rebind {
+        typedef PoolAllocator<U> other;
+    };
+
+    PoolAllocator() throw() {};
+    template < class U > PoolAllocator(const PoolAllocator<U>&) throw() {};
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T*>(PoolMalloc(n*sizeof(T)));
+    };
+
+    void deallocate(T *ptr,size_t n)
+    {
+        PoolFree(ptr,n*sizeof(T));
+    };
+};
+
+template < class T, class U > inline bool operator==(const PoolAllocator<T>&,const PoolAllocator<U>&)
+{
+    return true;
+}
+template < class T, class U > inline bool operator!=(const PoolAllocator<T>&,const PoolAllocator<U>&)
+{
+    return false;
+}
+
+//!
+//! \brief std compatible allocator drawing from an Arena. deallocate does nothing.
+//!
+template < class T > struct ArenaAllocator {
+    typedef T value_type;
+    template < class U > struct rebind {
+        typedef ArenaAllocator<U> other;
+    };
+
+    ArenaAllocator(Arena& arena_in) throw():arena(&arena_in) {};
+    template < class U > ArenaAllocator(const ArenaAllocator<U>& a) throw():arena(a.arena) {};
+
+    T *allocate(size_t n)
+    {
+        size_t a = (alignof(T)<sizeof(void*)) ? sizeof(void*):alignof(T);
+        return static_cast<T*>(arena->allocate(n*sizeof(T),a));
+    };
+
+    void deallocate(T*,size_t)
+    {
+    };
+
+    Arena *arena;
+};
+
+template < class T, class U > inline bool operator==(const ArenaAllocator<T>& a,const ArenaAllocator<U>& b)
+{
+    return a.arena==b.arena;
+}
+template < class T, class U > inline bool operator!=(const ArenaAllocator<T>& a,const ArenaAllocator<U>& b)
+{
+    return a.arena!=b.arena;
+}
+
+}
+#endif /* ALLOCATORS_HPP_ */
@@ -0,0 +1,242 @@
+/*
+ * ArgumentReader.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef ARGUMENTREADER_HPP_
+#define ARGUMENTREADER_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include "putils.hpp"
+#include "FilePathUtils.h"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief reads command line arguments one at a time, expanding @file response files as it goes.
+//!
+//!  An argument @name, where name is a regular file, is replaced by the arguments in the file. The
+//!  file is mapped and split into words following the shell: words are separated by blanks and
+//!  line breaks, '...' quotes literally, "..." quotes with a backslash escaping " \ $ ` and line
+//!  breaks, a backslash outside quotes escapes the next character (a line break is then dropped)
+//!  and # at the start of a word comments out the rest of the line. Response files may name further response files;
+//!  a file which includes itself, directly or not, is an error. Relative names are taken from the
+//!  current directory. An @name which is not a regular file is passed on unchanged.
+//!
+//!  Arguments are handed out as pointer and length without copying: argv entries and unquoted
+//!  words point into argv or the mapped file. Only words using quotes or escapes are built, in one
+//!  of two buffers, so the argument returned by next stays valid while one more is peeked at.
+//!
+class ArgumentReader {
+public:
+    ArgumentReader(int argc_in,char **argv_in,int first=1,bool expand_in=true):
+        argc(argc_in),argv(argv_in),karg(first),expand(expand_in),have_peek(false),peek_arg(0),peek_len(0),slot(0)
+    {
+    };
+
+    virtual ~ArgumentReader()
+    {
+    };
+
+    //!
+    //! \brief the next argument, false at the end
+    //!
+    bool next(const char *& arg,size_t& len)
+    {
+        if (have_peek) {
+            have_peek = false;
+            arg = peek_arg;
+            len = peek_len;
+            return true;
+        }
+        return fetch(arg,len);
+    };
+
+    //!
+    //! \brief the argument next will return, without consuming it
+    //!
+    bool peek(const char *& arg,size_t& len)
+    {
+        if (!have_peek) {
+            if (!fetch(peek_arg,peek_len)) return false;
+            have_peek = true;
+        }
+        arg = peek_arg;
+        len = peek_len;
+        return true;
+    };
+
+    //!
+    //! \brief the index in argv of the argument next will return, false while the arguments come
+    //!  from a response file or one has been peeked at
+    //!
+    bool position(int& k) const throw ()
+    {
+        if (!stack.empty() || have_peek) return false;
+        k = karg;
+        return true;
+    };
+
+private:
+    ArgumentReader(const ArgumentReader&);
+    ArgumentReader& operator=(const ArgumentReader&);
+
+    struct source_t {
+        string name;
+        shared_ptr<MappedFile> file;
+        const char *p;
+        const char *end;
+        unsigned long long dev;
+        unsigned long long ino;
+    };
+
+    int argc;
+    char **argv;
+    int karg;
+    bool expand;
+    bool have_peek;
+    const char *peek_arg;
+    size_t peek_len;
+    vector<source_t> stack;
+    vector< shared_ptr<MappedFile> > opened;
+    string scratch[2];
+    int slot;
+
+    bool fetch(const char *& arg,size_t& len)
+    {
+        for (;;) {
+            bool plain = true;
+            if (!stack.empty()) {
+                if (!readWord(stack.back(),arg,len,plain)) {
+                    stack.pop_back();
+                    continue;
+                }
+            }
+            else {
+                if (karg>=argc) return false;
+                arg = argv[karg++];
+                len = strlen(arg);
+            }
+            if (expand && plain && len>1 && arg[0]=='@' && include(string(arg+1,len-1))) continue;
+            return true;
+        }
+    };
+
+    //!
+    //! \brief start reading the response file name. Returns false if it is not a regular file.
+    //!
+    bool include(const string& name)
+    {
+        FileInfo info(name);
+        if (!info.isRegularFile()) return false;
+        source_t src;
+        info.identity(src.dev,src.ino);
+        for (size_t k=0; k<stack.size(); ++k) {
+            if (stack[k].dev==src.dev && stack[k].ino==src.ino) {
+                string err("response file ");
+                err += name + " includes itself through " + stack[k].name;
+                throw ParseError(err);
+            }
+        }
+        src.name = name;
+        src.file.reset(new MappedFile(name));
+        // the arguments handed out point into the file, keep it mapped after it is read
+        opened.push_back(src.file);
+        src.p = src.file->data();
+        src.end = src.p+src.file->size();
+        stack.push_back(src);
+        return true;
+    };
+
+    static bool isBlank(char ch) throw ()
+    {
+        return ch==' ' || ch=='\t' || ch=='\n' || ch=='\r' || ch=='\f' || ch=='\v';
+    };
+
+    //!
+    //! \brief split the next word from src. plain is false if it used quotes or escapes.
+    //!
+    bool readWord(source_t& src,const char *& arg,size_t& len,bool& plain)
+    {
+        const char *p = src.p;
+        const char *end = src.end;
+        for (;;) {
+            while (p<end && isBlank(*p)) ++p;
+            if (p<end && *p=='#') {
+                while (p<end && *p!='\n') ++p;
+                continue;
+            }
+            if (p+1<end && *p=='\\' && p[1]=='\n') {
+                p += 2;
+                continue;
+            }
+            break;
+        }
+        if (p==end) {
+            src.p = p;
+            return false;
+        }
+        const char *start = p;
+        while (p<end && !isBlank(*p) && *p!='\'' && *p!='"' && *p!='\\') ++p;
+        if (p==end || isBlank(*p)) {
+            src.p = p;
+            arg = start;
+            len = p-start;
+            plain = true;
+            return true;
+        }
+        // quotes or escapes, build the word
+        string& word = scratch[slot];
+        slot ^= 1;
+        word.assign(start,p);
+        while (p<end && !isBlank(*p)) {
+            char ch = *p++;
+            if (ch=='\\') {
+                if (p==end) break;
+                if (*p!='\n') word.push_back(*p);
+                ++p;
+            }
+            else if (ch=='\'') {
+                const char *q = static_cast<const char*>(memchr(p,'\'',end-p));
+                if (!q) unterminated(src);
+                word.append(p,q);
+                p = q+1;
+            }
+            else if (ch=='"') {
+                while (p<end && *p!='"') {
+                    if (*p=='\\' && p+1<end && (p[1]=='"' || p[1]=='\\' || p[1]=='$' || p[1]=='`' || p[1]=='\n')) {
+                        if (p[1]!='\n') word.push_back(p[1]);
+                        p += 2;
+                        continue;
+                    }
+                    word.push_back(*p++);
+                }
+                if (p==end) unterminated(src);
+                ++p;
+            }
+            else {
+                word.push_back(ch);
+            }
+        }
+        src.p = p;
+        arg = word.data();
+        len = word.size();
+        plain = false;
+        return true;
+    };
+
+    static void unterminated(const source_t& src)
+    {
+        string err("unterminated quote in response file ");
+        err += src.name;
+        throw ParseError(err);
+    };
+};
+
+}
+#endif /* ARGUMENTREADER_HPP_ */
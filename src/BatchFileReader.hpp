@@ -0,0 +1,519 @@
+/*
+ * BatchFileReader.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef BATCHFILEREADER_HPP_
+#define BATCHFILEREADER_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+extern "C" {
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+}
+#include <unistd.h>
+#include "putils.hpp"
+#include "FilePathUtils.h"
+#include "ThreadPool.hpp"
+using namespace std;
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+extern "C" {
+#include <linux/io_uring.h>
+}
+#endif
+
+namespace putils {
+
+#ifdef HAVE_IO_URING
+//!
+//! \brief a minimal io_uring instance driven through the raw system calls.
+//!
+//!  Throws a SystemError from the constructor when the kernel does not provide io_uring or
+//!  refuses to create one (e.g. seccomp filtered containers). The kernel is asked which operations
+//!  it supports; supports() is false for all of them when it cannot answer (before Linux 5.6).
+//!
+class IoUring {
+public:
+    IoUring(unsigned entries):fd(-1),sq_ptr(MAP_FAILED),cq_ptr(MAP_FAILED),sqes(0)
+    {
+        io_uring_params p;
+        memset(&p,0,sizeof(p));
+        errno = 0;
+        fd = syscall(__NR_io_uring_setup,entries,&p);
+        if (fd<0) throw SystemError(string("IoUring setup failed"),errno);
+        sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries*sizeof(io_uring_cqe);
+        single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap && cq_size>sq_size) sq_size = cq_size;
+        sq_ptr = mmap(0,sq_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQ_RING);
+        if (sq_ptr==MAP_FAILED) fail("IoUring could not map the submission ring");
+        if (single_mmap) {
+            cq_ptr = sq_ptr;
+        }
+        else {
+            cq_ptr = mmap(0,cq_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_CQ_RING);
+            if (cq_ptr==MAP_FAILED) fail("IoUring could not map the completion ring");
+        }
+        sqes_size = p.sq_entries*sizeof(io_uring_sqe);
+        void *s = mmap(0,sqes_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQES);
+        if (s==MAP_FAILED) fail("IoUring could not map the submission entries");
+        sqes = static_cast<io_uring_sqe*>(s);
+        char *sq = static_cast<char*>(sq_ptr);
+        char *cq = static_cast<char*>(cq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq+p.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq+p.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq+p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq+p.sq_off.array);
+        sq_entries = p.sq_entries;
+        cq_head = reinterpret_cast<unsigned*>(cq+p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq+p.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq+p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq+p.cq_off.cqes);
+        pending = 0;
+        probe();
+    };
+
+    virtual ~IoUring()
+    {
+        release();
+    };
+
+    //!
+    //! \brief return a cleared submission entry or null when the ring is full
+    //!
+    io_uring_sqe *getSqe()
+    {
+        unsigned head = __atomic_load_n(sq_head,__ATOMIC_ACQUIRE);
+        unsigned tail = *sq_tail + pending;
+        if (tail-head>=sq_entries) return 0;
+        unsigned idx = tail & sq_mask;
+        io_uring_sqe *sqe = &sqes[idx];
+        memset(sqe,0,sizeof(*sqe));
+        sq_array[idx] = idx;
+        ++pending;
+        return sqe;
+    };
+
+    //!
+    //! \brief submit the prepared entries and wait for at least wait_nr completions
+    //!
+    void submit(unsigned wait_nr)
+    {
+        unsigned n = pending;
+        __atomic_store_n(sq_tail,*sq_tail+pending,__ATOMIC_RELEASE);
+        pending = 0;
+        for (;;) {
+            errno = 0;
+            long ret = syscall(__NR_io_uring_enter,fd,n,wait_nr,(wait_nr)?IORING_ENTER_GETEVENTS:0,0,0);
+            if (ret>=0) return;
+            if (errno!=EINTR) throw SystemError(string("IoUring enter failed"),errno);
+            n = 0;
+        }
+    };
+
+    //!
+    //! \brief return the next completion or null, call seen() once it has been used
+    //!
+    io_uring_cqe *peek()
+    {
+        unsigned head = *cq_head;
+        if (head==__atomic_load_n(cq_tail,__ATOMIC_ACQUIRE)) return 0;
+        return &cqes[head & cq_mask];
+    };
+
+    void seen()
+    {
+        __atomic_store_n(cq_head,*cq_head+1,__ATOMIC_RELEASE);
+    };
+
+    unsigned capacity() const throw()
+    {
+        return sq_entries;
+    };
+
+    //!
+    //! \brief true when the kernel reported that it supports the operation opcode
+    //!
+    bool supports(unsigned opcode) const throw()
+    {
+        return opcode<supported.size() && supported[opcode];
+    };
+
+private:
+    IoUring(const IoUring&);
+    IoUring& operator=(const IoUring&);
+
+    int fd;
+    bool single_mmap;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+    io_uring_sqe *sqes;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned pending;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe *cqes;
+    vector<bool> supported;
+
+    void probe()
+    {
+#ifdef IO_URING_OP_SUPPORTED
+        const unsigned nops = 256;
+        vector<char> buf(sizeof(io_uring_probe)+nops*sizeof(io_uring_probe_op),0);
+        io_uring_probe *pr = reinterpret_cast<io_uring_probe*>(&buf[0]);
+        if (syscall(__NR_io_uring_register,fd,IORING_REGISTER_PROBE,pr,nops)<0) return;
+        supported.assign(nops,false);
+        for (unsigned k=0; k<pr->ops_len && k<nops; ++k) {
+            if (pr->ops[k].flags & IO_URING_OP_SUPPORTED) supported[pr->ops[k].op] = true;
+        }
+#endif
+    };
+
+    void release()
+    {
+        if (sqes) munmap(sqes,sqes_size);
+        if (cq_ptr!=MAP_FAILED && cq_ptr!=sq_ptr) munmap(cq_ptr,cq_size);
+        if (sq_ptr!=MAP_FAILED) munmap(sq_ptr,sq_size);
+        if (fd>=0) close(fd);
+        sqes = 0;
+        fd = -1;
+        sq_ptr = cq_ptr = MAP_FAILED;
+    };
+
+    void fail(const char *msg)
+    {
+        int e = errno;
+        release();
+        throw SystemError(string(msg),e);
+    };
+};
+#endif
+
+//!
+//! \brief reads a set of whole files at once, handing each to a callback as soon as it has arrived.
+//!
+//!  With io_uring the opens and statx calls of all files go to the kernel as one batch, followed by
+//!  one batch with all of the reads, so the total wait is close to that of the slowest file. Without
+//!  io_uring, or when the kernel refuses to set one up, the files are read by a pool of threads.
+//!  The callback receives the index of the file in the list, an errno value (zero on success) and
+//!  the file contents. It may be called from several threads at once in the thread pool case.
+//!  Only regular files are read, anything else is reported with EINVAL. The ring is only used when
+//!  the kernel supports opening, statx and reading through it. If the callback throws, the reads
+//!  still in flight are waited for and the files closed before the exception leaves readAll.
+//!
+class BatchFileReader {
+public:
+    typedef function<void(size_t index,int error,const char *data,size_t len)> callback_t;
+
+    BatchFileReader():use_io_uring(true),nthreads(0)
+    {
+    };
+
+    virtual ~BatchFileReader()
+    {
+    };
+    //!
+    //! \brief allow or forbid the io_uring path
+    //!
+    void setUseIoUring(bool flag)
+    {
+        use_io_uring = flag;
+    };
+    //!
+    //! \brief the number of threads used when io_uring is not available. zero means one per hardware thread.
+    //!
+    void setThreads(size_t n)
+    {
+        nthreads = n;
+    };
+
+    void readAll(const vector<string>& files,const callback_t& callback)
+    {
+        if (files.empty()) return;
+#ifdef HAVE_IO_URING
+        if (use_io_uring) {
+            unsigned depth = 8;
+            while (depth<2*files.size() && depth<4096) depth *= 2;
+            unique_ptr<IoUring> ring;
+            try {
+                ring.reset(new IoUring(depth));
+            }
+            catch (SystemError& e) {
+                // no io_uring here, read with threads instead
+            }
+            if (ring && ring->supports(IORING_OP_OPENAT) && ring->supports(IORING_OP_STATX) &&
+                    ring->supports(IORING_OP_READ)) {
+                readWithIoUring(*ring,files,callback);
+                return;
+            }
+        }
+#endif
+        readWithThreads(files,callback);
+    };
+
+    //!
+    //! \brief read a single whole file with blocking calls. Returns an errno value, zero on success.
+    //!
+    static int readFile(const string& filename,string& contents)
+    {
+        contents.clear();
+        FileInfo info(filename);
+        if (!info.exists()) return info.error();
+        if (!info.isRegularFile()) return EINVAL;
+        errno = 0;
+        int fd = open(filename.c_str(),O_RDONLY|O_CLOEXEC);
+        if (fd==-1) return errno;
+        size_t cap = info.size() ? info.size():64*1024;
+        contents.resize(cap);
+        size_t len = 0;
+        for (;;) {
+            if (len==contents.size()) contents.resize(2*contents.size());
+            ssize_t n = read(fd,&contents[len],contents.size()-len);
+            if (n==-1) {
+                if (errno==EINTR) continue;
+                int e = errno;
+                close(fd);
+                return e;
+            }
+            if (n==0) break;
+            len += n;
+        }
+        close(fd);
+        contents.resize(len);
+        return 0;
+    };
+
+private:
+    bool use_io_uring;
+    size_t nthreads;
+
+    void readWithThreads(const vector<string>& files,const callback_t& callback)
+    {
+        size_t n = nthreads;
+        if (n==0 || n>files.size()) n = files.size();
+        ThreadPool pool(n);
+        for (size_t k=0; k<files.size(); ++k) {
+            const string& name = files[k];
+            pool.submit([&callback,&name,k]() {
+                string contents;
+                int e = readFile(name,contents);
+                callback(k,e,contents.data(),contents.size());
+            });
+        }
+        pool.wait();
+    };
+
+#ifdef HAVE_IO_URING
+    struct pending_t {
+        int fd;
+        int error;
+        struct statx stx;
+        string data;
+        size_t got;
+        bool done;
+    };
+
+    enum { OP_OPEN = 0, OP_STATX = 1, OP_READ = 2, OP_SHIFT = 2 };
+
+    void readWithIoUring(IoUring& ring,const vector<string>& files,const callback_t& callback)
+    {
+        size_t nfiles = files.size();
+        vector<pending_t> work(nfiles);
+        for (size_t k=0; k<nfiles; ++k) {
+            work[k].fd = -1;
+            work[k].error = 0;
+            work[k].got = 0;
+            work[k].done = false;
+        }
+        size_t inflight = 0;
+        try {
+            runBatches(ring,files,work,inflight,callback);
+        }
+        catch (...) {
+            // the kernel may still write into work, wait for it before closing what opened
+            drain(ring,inflight);
+            for (size_t k=0; k<nfiles; ++k) {
+                if (work[k].fd>=0) close(work[k].fd);
+            }
+            throw;
+        }
+    };
+
+    void runBatches(IoUring& ring,const vector<string>& files,vector<pending_t>& work,size_t& inflight,
+                    const callback_t& callback)
+    {
+        size_t nfiles = files.size();
+        // first batch, open and statx every file
+        size_t next = 0;
+        while (next<nfiles || inflight) {
+            while (next<nfiles && ring.capacity()-inflight>=2) {
+                io_uring_sqe *sqe = ring.getSqe();
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<unsigned long>(files[next].c_str());
+                sqe->open_flags = O_RDONLY|O_CLOEXEC;
+                sqe->user_data = (next<<OP_SHIFT)|OP_OPEN;
+                sqe = ring.getSqe();
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<unsigned long>(files[next].c_str());
+                sqe->len = STATX_TYPE|STATX_MODE|STATX_SIZE;
+                sqe->off = reinterpret_cast<unsigned long>(&work[next].stx);
+                sqe->user_data = (next<<OP_SHIFT)|OP_STATX;
+                inflight += 2;
+                ++next;
+            }
+            ring.submit(1);
+            reap(ring,work,inflight,callback);
+        }
+        // second batch, read every file which opened
+        for (size_t k=0; k<nfiles; ++k) {
+            pending_t& w = work[k];
+            if (w.done) continue;
+            if (!w.error && !S_ISREG(w.stx.stx_mode)) w.error = EINVAL;
+            if (w.error || w.stx.stx_size==0) {
+                // errors and files which report no size (procfs) are finished with blocking calls
+                if (w.fd>=0) close(w.fd);
+                w.fd = -1;
+                string contents;
+                int e = (w.error) ? w.error:readFile(files[k],contents);
+                w.done = true;
+                callback(k,e,contents.data(),contents.size());
+                continue;
+            }
+            w.data.resize(w.stx.stx_size);
+        }
+        next = 0;
+        while (next<nfiles || inflight) {
+            while (next<nfiles && inflight<ring.capacity()) {
+                pending_t& w = work[next];
+                if (!w.done) {
+                    queueRead(ring,w,next);
+                    ++inflight;
+                }
+                ++next;
+            }
+            if (!inflight) break;
+            ring.submit(1);
+            reap(ring,work,inflight,callback);
+        }
+    };
+
+    //!
+    //! \brief wait for the operations in flight, closing the files their opens return
+    //!
+    void drain(IoUring& ring,size_t& inflight) throw ()
+    {
+        try {
+            while (inflight) {
+                ring.submit(1);
+                io_uring_cqe *cqe;
+                while ((cqe = ring.peek())) {
+                    if ((cqe->user_data & ((1<<OP_SHIFT)-1))==OP_OPEN && cqe->res>=0) close(cqe->res);
+                    ring.seen();
+                    --inflight;
+                }
+            }
+        }
+        catch (...) {
+            // the ring no longer works, nothing more can be waited for
+        }
+    };
+
+    void queueRead(IoUring& ring,pending_t& w,size_t k)
+    {
+        io_uring_sqe *sqe = ring.getSqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = w.fd;
+        sqe->addr = reinterpret_cast<unsigned long>(&w.data[w.got]);
+        sqe->len = w.data.size()-w.got;
+        sqe->off = w.got;
+        sqe->user_data = (k<<OP_SHIFT)|OP_READ;
+    };
+
+    //!
+    //! \brief process the available completions. Short reads are queued again for the rest of the file.
+    //!
+    void reap(IoUring& ring,vector<pending_t>& work,size_t& inflight,const callback_t& callback)
+    {
+        io_uring_cqe *cqe;
+        while ((cqe = ring.peek())) {
+            unsigned long long ud = cqe->user_data;
+            int res = cqe->res;
+            ring.seen();
+            --inflight;
+            size_t k = ud>>OP_SHIFT;
+            pending_t& w = work[k];
+            switch (ud & ((1<<OP_SHIFT)-1)) {
+            case OP_OPEN:
+                if (res<0) {
+                    if (!w.error) w.error = -res;
+                }
+                else {
+                    w.fd = res;
+                }
+                break;
+            case OP_STATX:
+                if (res<0 && !w.error) w.error = -res;
+                break;
+            case OP_READ:
+                if (res<0 && res!=-EINTR && res!=-EAGAIN) {
+                    finish(w,k,-res,callback);
+                }
+                else if (res==0) {
+                    // the file shrank after statx
+                    w.data.resize(w.got);
+                    finish(w,k,0,callback);
+                }
+                else {
+                    if (res>0) w.got += res;
+                    if (w.got==w.data.size()) {
+                        finish(w,k,0,callback);
+                    }
+                    else {
+                        queueRead(ring,w,k);
+                        ++inflight;
+                    }
+                }
+                break;
+            }
+        }
+    };
+
+    void finish(pending_t& w,size_t k,int error,const callback_t& callback)
+    {
+        close(w.fd);
+        w.fd = -1;
+        w.done = true;
+        callback(k,error,w.data.data(),(error)?0:w.data.size());
+        string().swap(w.data);
+    };
+#endif
+};
+
+}
+#endif /* BATCHFILEREADER_HPP_ */
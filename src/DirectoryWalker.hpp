@@ -0,0 +1,413 @@
+/*
+ * DirectoryWalker.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef DIRECTORYWALKER_HPP_
+#define DIRECTORYWALKER_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+extern "C" {
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <fnmatch.h>
+}
+#include <unistd.h>
+#include "putils.hpp"
+#include "FilePathUtils.h"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief one entry found by the DirectoryWalker
+//!
+struct DirEntry {
+    string path;
+    FileInfo info;
+
+    DirEntry(const string& path_in,const FileInfo& info_in):path(path_in),info(info_in) {};
+
+    bool operator<(const DirEntry& e) const
+    {
+        return path<e.path;
+    };
+};
+
+//!
+//! \brief enumerates the files below a directory.
+//!
+//!  Directories are read with getdents64 through descriptors opened with openat relative to their
+//!  parent, which stays open until its last subdirectory has been opened, so no path is resolved
+//!  twice and none is limited by PATH_MAX. The d_type of each entry decides whether it is descended
+//!  into, so no stat call is made unless the file system does not report types or setStat(true)
+//!  asks for full FileInfo records. In that case the entry is examined relative to its open
+//!  directory. Subdirectories are spread across worker threads, each with its own queue, and idle
+//!  workers steal from the others or sleep until there is work. Symbolic links are reported but
+//!  never followed. The entries are returned sorted by path. The first error met by any worker is
+//!  thrown by walk once the workers have finished.
+//!
+class DirectoryWalker {
+public:
+    DirectoryWalker():nthreads(0),want_stat(false),recursive(true),want_dirs(false)
+    {
+    };
+
+    virtual ~DirectoryWalker()
+    {
+    };
+    //!
+    //! \brief only report files whose name matches the glob pattern (any added pattern or suffix may match)
+    //!
+    void addPattern(const string& pattern)
+    {
+        patterns.push_back(pattern);
+    };
+    //!
+    //! \brief only report files whose name ends in suffix (any added pattern or suffix may match)
+    //!
+    void addSuffix(const string& suffix)
+    {
+        suffixes.push_back(suffix);
+    };
+    //!
+    //! \brief number of worker threads, zero means one per hardware thread
+    //!
+    void setThreads(size_t n)
+    {
+        nthreads = n;
+    };
+    //!
+    //! \brief examine each reported entry for permissions, size and times
+    //!
+    void setStat(bool flag)
+    {
+        want_stat = flag;
+    };
+    //!
+    //! \brief descend into subdirectories (the default) or read only the top directory
+    //!
+    void setRecursive(bool flag)
+    {
+        recursive = flag;
+    };
+    //!
+    //! \brief report directories as well as files
+    //!
+    void setReportDirectories(bool flag)
+    {
+        want_dirs = flag;
+    };
+
+    //!
+    //! \brief walk the tree below root and place the matching entries in entries. Returns their number.
+    //!
+    size_t walk(const string& root,vector<DirEntry>& entries)
+    {
+        entries.clear();
+        errno = 0;
+        int root_fd = open(root.c_str(),O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        if (root_fd==-1) {
+            string err("DirectoryWalker could not open ");
+            err += root;
+            throw SystemError(err,errno);
+        }
+        size_t nw = nthreads;
+        if (nw==0) nw = thread::hardware_concurrency();
+        if (nw==0) nw = 1;
+
+        Shared shared(root,nw);
+        shared.queues[0].items.push_back(DirItem(make_shared<DirHandle>(root_fd),".",string()));
+        shared.queued = 1;
+        shared.pending = 1;
+        if (nw==1) {
+            work(shared,0);
+        }
+        else {
+            vector<thread> workers;
+            for (size_t k=0; k<nw; ++k) workers.push_back(thread(&DirectoryWalker::work,this,ref(shared),k));
+            for (size_t k=0; k<nw; ++k) workers[k].join();
+        }
+        if (shared.error) rethrow_exception(shared.error);
+        for (size_t k=0; k<nw; ++k) {
+            entries.insert(entries.end(),shared.results[k].begin(),shared.results[k].end());
+        }
+        sort(entries.begin(),entries.end());
+        return entries.size();
+    };
+
+private:
+    size_t nthreads;
+    bool want_stat;
+    bool recursive;
+    bool want_dirs;
+    vector<string> patterns;
+    vector<string> suffixes;
+
+    struct linux_dirent64_t {
+        unsigned long long d_ino;
+        long long d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+
+    //!
+    //! \brief an open directory, closed when the last subdirectory waiting on it has been opened
+    //!
+    struct DirHandle {
+        int fd;
+
+        explicit DirHandle(int fd_in):fd(fd_in) {};
+
+        ~DirHandle()
+        {
+            close(fd);
+        };
+
+    private:
+        DirHandle(const DirHandle&);
+        DirHandle& operator=(const DirHandle&);
+    };
+
+    //!
+    //! \brief a directory to read: its name in the open parent and its path below the root
+    //!
+    struct DirItem {
+        shared_ptr<DirHandle> parent;
+        string name;
+        string rel;
+
+        DirItem() {};
+        DirItem(const shared_ptr<DirHandle>& parent_in,const string& name_in,const string& rel_in):
+            parent(parent_in),name(name_in),rel(rel_in) {};
+    };
+
+    struct WorkQueue {
+        mutex mtx;
+        deque<DirItem> items;
+    };
+
+    struct Shared {
+        string prefix;
+        vector<WorkQueue> queues;
+        vector< vector<DirEntry> > results;
+        atomic<size_t> queued;
+        atomic<size_t> pending;
+        mutex idle_mtx;
+        condition_variable idle_cv;
+        mutex error_mtx;
+        exception_ptr error;
+
+        Shared(const string& root,size_t n):
+            prefix(root),queues(n),results(n),queued(0),pending(0),idle_mtx(),idle_cv(),error_mtx(),error()
+        {
+            // paths are prefix/name, so the root directory itself contributes no characters
+            while (prefix.size() && prefix[prefix.size()-1]=='/') prefix.erase(prefix.size()-1);
+        };
+
+        //!
+        //! \brief wake the idle workers, after work was queued or the last directory was done
+        //!
+        void wake()
+        {
+            lock_guard<mutex> lock(idle_mtx);
+            idle_cv.notify_all();
+        };
+    };
+
+    //!
+    //! \brief take a directory from our own queue (newest first) or steal from another (oldest first)
+    //!
+    bool take(Shared& shared,size_t self,DirItem& dir)
+    {
+        {
+            WorkQueue& q = shared.queues[self];
+            lock_guard<mutex> lock(q.mtx);
+            if (!q.items.empty()) {
+                dir = q.items.back();
+                q.items.pop_back();
+                shared.queued.fetch_sub(1);
+                return true;
+            }
+        }
+        size_t n = shared.queues.size();
+        for (size_t k=1; k<n; ++k) {
+            WorkQueue& q = shared.queues[(self+k)%n];
+            lock_guard<mutex> lock(q.mtx);
+            if (!q.items.empty()) {
+                dir = q.items.front();
+                q.items.pop_front();
+                shared.queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    };
+
+    void work(Shared& shared,size_t self)
+    {
+        DirItem dir;
+        while (shared.pending.load()) {
+            if (!take(shared,self,dir)) {
+                unique_lock<mutex> lock(shared.idle_mtx);
+                shared.idle_cv.wait(lock,[&shared]() { return shared.queued.load()>0 || shared.pending.load()==0; });
+                continue;
+            }
+            size_t added = 0;
+            try {
+                added = scan(shared,self,dir);
+            }
+            catch (...) {
+                lock_guard<mutex> lock(shared.error_mtx);
+                if (!shared.error) shared.error = current_exception();
+            }
+            dir = DirItem();
+            if (shared.pending.fetch_sub(1)==1 || added) shared.wake();
+        }
+    };
+
+    bool matches(const char *name,size_t len) const
+    {
+        if (patterns.empty() && suffixes.empty()) return true;
+        for (size_t k=0; k<suffixes.size(); ++k) {
+            const string& s = suffixes[k];
+            if (len>=s.size() && memcmp(name+len-s.size(),s.data(),s.size())==0) return true;
+        }
+        for (size_t k=0; k<patterns.size(); ++k) {
+            if (fnmatch(patterns[k].c_str(),name,0)==0) return true;
+        }
+        return false;
+    };
+
+    static mode_t typeBits(unsigned char d_type)
+    {
+        switch (d_type) {
+        case DT_REG:
+            return S_IFREG;
+        case DT_DIR:
+            return S_IFDIR;
+        case DT_LNK:
+            return S_IFLNK;
+        case DT_FIFO:
+            return S_IFIFO;
+        case DT_SOCK:
+            return S_IFSOCK;
+        case DT_CHR:
+            return S_IFCHR;
+        case DT_BLK:
+            return S_IFBLK;
+        default:
+            return 0;
+        }
+    };
+
+    //!
+    //! \brief read one directory, reporting its entries and queueing its subdirectories. Returns
+    //!  the number queued.
+    //!
+    size_t scan(Shared& shared,size_t self,const DirItem& dir)
+    {
+        const string& rel = dir.rel;
+        errno = 0;
+        int dir_fd = openat(dir.parent->fd,dir.name.c_str(),O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+        if (dir_fd==-1) {
+            // the directory vanished or is unreadable, neither stops the walk
+            if (errno==ENOENT || errno==EACCES) return 0;
+            string err("DirectoryWalker could not open ");
+            err += shared.prefix + "/" + rel;
+            throw SystemError(err,errno);
+        }
+        shared_ptr<DirHandle> handle = make_shared<DirHandle>(dir_fd);
+        int fd = handle->fd;
+        size_t added = 0;
+        vector<DirEntry>& out = shared.results[self];
+        char buf[64*1024];
+        for (;;) {
+            long n = syscall(SYS_getdents64,fd,buf,sizeof(buf));
+            if (n==0) break;
+            if (n<0) {
+                string err("DirectoryWalker could not read ");
+                err += shared.prefix + "/" + rel;
+                throw SystemError(err,errno);
+            }
+            for (long off=0; off<n;) {
+                linux_dirent64_t *d = reinterpret_cast<linux_dirent64_t*>(buf+off);
+                off += d->d_reclen;
+                const char *name = d->d_name;
+                if (name[0]=='.' && (name[1]==0 || (name[1]=='.' && name[2]==0))) continue;
+                size_t len = strlen(name);
+                mode_t type = typeBits(d->d_type);
+                FileInfo info;
+                bool examined = false;
+                if (type==0 || (want_stat && !S_ISDIR(type))) {
+                    info = FileInfo(fd,name);
+                    examined = true;
+                    if (info.isLink()) type = S_IFLNK;
+                    else if (info.exists()) type = (info.isDirectory()) ? mode_t(S_IFDIR):mode_t(S_IFREG);
+                    else continue;
+                }
+                string path = (rel.size()) ? rel + "/" + string(name,len):string(name,len);
+                if (S_ISDIR(type)) {
+                    if (want_dirs) {
+                        if (want_stat && !examined) info = FileInfo(fd,name);
+                        else if (!examined) info = FileInfo::fromType(type);
+                        out.push_back(DirEntry(shared.prefix + "/" + path,info));
+                    }
+                    if (recursive) {
+                        DirItem item(handle,string(name,len),path);
+                        // counted before it is queued so that pending never reaches zero early
+                        shared.pending.fetch_add(1);
+                        WorkQueue& q = shared.queues[self];
+                        lock_guard<mutex> lock(q.mtx);
+                        try {
+                            q.items.push_back(item);
+                        }
+                        catch (...) {
+                            shared.pending.fetch_sub(1);
+                            throw;
+                        }
+                        shared.queued.fetch_add(1);
+                        ++added;
+                    }
+                    continue;
+                }
+                if (!matches(name,len)) continue;
+                if (!examined) info = FileInfo::fromType(type);
+                out.push_back(DirEntry(shared.prefix + "/" + path,info));
+            }
+        }
+        return added;
+    };
+};
+
+//!
+//! \brief return the files below dir whose names match the glob pattern, sorted by path
+//!
+inline vector<DirEntry> findFiles(const string& dir,const string& pattern,bool recursive=true)
+{
+    DirectoryWalker walker;
+    walker.addPattern(pattern);
+    walker.setRecursive(recursive);
+    vector<DirEntry> entries;
+    walker.walk(dir,entries);
+    return entries;
+}
+
+}
+#endif /* DIRECTORYWALKER_HPP_ */
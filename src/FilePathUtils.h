@@ -7,161 +7,570 @@
 #include <cerrno>
 #include <fstream>
 #include <iostream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <ctime>
 extern "C" {
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
 }
 #include <unistd.h>
 #include <stdexcept>
+#include "putils.hpp"
 using namespace std;
 
 namespace putils {
 
-inline bool isRegularFile(const string& filename)
-{
-    struct stat64 fst;
-    errno = 0;
-    int e = stat64(filename.c_str(),&fst);
-    int ecode = errno;
-    if (e==-1) {
-        if (ecode == ENOENT) {
+//!
+//! \brief the metadata of one path, gathered with a single statx call.
+//!
+//!  Symbolic links are not followed by the first call so isLink is meaningful. Only when the path is
+//!  a link is a second call made to describe its target, which is what the other queries answer about.
+//!  If the path could not be examined exists() is false and error() returns the errno value.
+//!
+class FileInfo {
+public:
+    FileInfo():err(ENOENT),link(false),mode(0),nbytes(0),mtime_sec(0),mtime_nsec(0),dev(0),ino(0)
+    {
+    };
+
+    FileInfo(const string& filename):err(0),link(false),mode(0),nbytes(0),mtime_sec(0),mtime_nsec(0),dev(0),ino(0)
+    {
+        examine(AT_FDCWD,filename.c_str());
+    };
+
+    //!
+    //! \brief examine the entry name relative to the open directory dirfd
+    //!
+    FileInfo(int dirfd,const char *name):err(0),link(false),mode(0),nbytes(0),mtime_sec(0),mtime_nsec(0),dev(0),ino(0)
+    {
+        examine(dirfd,name);
+    };
+
+    //!
+    //! \brief describe an entry from only its file type bits, e.g. from a directory entry's d_type.
+    //!  Permissions, size and times are unknown and read as zero.
+    //!
+    static FileInfo fromType(mode_t type_bits)
+    {
+        FileInfo info;
+        info.err = 0;
+        info.mode = type_bits & S_IFMT;
+        info.link = S_ISLNK(info.mode);
+        return info;
+    };
+
+    bool exists() const throw()
+    {
+        return err==0;
+    };
+    int error() const throw()
+    {
+        return err;
+    };
+    bool isRegularFile() const throw()
+    {
+        return exists() && S_ISREG(mode);
+    };
+    bool isDirectory() const throw()
+    {
+        return exists() && S_ISDIR(mode);
+    };
+    bool isLink() const throw()
+    {
+        return link;
+    };
+    bool canRead() const throw()
+    {
+        return exists() && (mode & S_IRUSR);
+    };
+    bool canWrite() const throw()
+    {
+        return exists() && (mode & S_IWUSR);
+    };
+    bool canExecute() const throw()
+    {
+        return exists() && (mode & S_IXUSR);
+    };
+    size_t size() const throw()
+    {
+        return (exists()) ? nbytes:0;
+    };
+    mode_t permissions() const throw()
+    {
+        return mode & 07777;
+    };
+    //!
+    //! \brief modification time, seconds and nanoseconds since the epoch
+    //!
+    void modificationTime(long long& sec,long& nsec) const throw()
+    {
+        sec = mtime_sec;
+        nsec = mtime_nsec;
+    };
+    //!
+    //! \brief device and inode numbers which identify the file
+    //!
+    void identity(unsigned long long& device,unsigned long long& inode) const throw()
+    {
+        device = dev;
+        inode = ino;
+    };
+
+private:
+    int err;
+    bool link;
+    mode_t mode;
+    size_t nbytes;
+    long long mtime_sec;
+    long mtime_nsec;
+    unsigned long long dev;
+    unsigned long long ino;
+
+    void examine(int dirfd,const char *name)
+    {
+        if (!statPath(dirfd,name,false)) return;
+        if (S_ISLNK(mode)) {
+            // a dangling link exists() false but is still a link
+            link = true;
+            statPath(dirfd,name,true);
+        }
+    };
+
+    bool statPath(int dirfd,const char *name,bool follow)
+    {
+        errno = 0;
+#ifdef STATX_BASIC_STATS
+        struct statx stx;
+        int flags = (follow) ? 0:AT_SYMLINK_NOFOLLOW;
+        if (statx(dirfd,name,flags,STATX_TYPE|STATX_MODE|STATX_SIZE|STATX_MTIME|STATX_INO,&stx)==-1) {
+            err = errno;
             return false;
         }
-        string msg("FileInfo::isRegularFile error ");
-        msg += strerror(ecode);
-        cerr << msg << endl;
-        return false;
-    }
-    return S_ISREG(fst.st_mode);
+        mode = stx.stx_mode;
+        nbytes = stx.stx_size;
+        mtime_sec = stx.stx_mtime.tv_sec;
+        mtime_nsec = stx.stx_mtime.tv_nsec;
+        dev = makedev(stx.stx_dev_major,stx.stx_dev_minor);
+        ino = stx.stx_ino;
+#else
+        struct stat64 fst;
+        int flags = (follow) ? 0:AT_SYMLINK_NOFOLLOW;
+        if (fstatat64(dirfd,name,&fst,flags)==-1) {
+            err = errno;
+            return false;
+        }
+        mode = fst.st_mode;
+        nbytes = fst.st_size;
+        mtime_sec = fst.st_mtim.tv_sec;
+        mtime_nsec = fst.st_mtim.tv_nsec;
+        dev = fst.st_dev;
+        ino = fst.st_ino;
+#endif
+        err = 0;
+        return true;
+    };
+};
+
+//!
+//! \brief a bounded, thread safe cache of FileInfo records keyed by path.
+//!
+//!  An entry is examined again once it is older than max_age seconds (zero means entries never
+//!  expire by age) or after invalidate() has advanced the generation. When the cache holds
+//!  max_entries paths the least recently used one is dropped.
+//!
+class StatCache {
+public:
+    StatCache(size_t max_entries_in=4096,double max_age_in=1.0):
+        max_entries(max_entries_in?max_entries_in:1),max_age(max_age_in),generation(0),
+        hit_count(0),miss_count(0)
+    {
+    };
+
+    virtual ~StatCache()
+    {
+    };
+
+    //!
+    //! \brief return the information for filename, from the cache when it is still valid
+    //!
+    FileInfo lookup(const string& filename)
+    {
+        double now = (max_age>0.) ? clockNow():0.;
+        {
+            lock_guard<mutex> lock(mtx);
+            map_t::iterator iter = entries.find(filename);
+            if (iter!=entries.end()) {
+                entry_t& e = iter->second;
+                if (e.gen==generation && (max_age<=0. || now-e.when<max_age)) {
+                    lru.splice(lru.begin(),lru,e.pos);
+                    ++hit_count;
+                    return e.info;
+                }
+            }
+        }
+        FileInfo info(filename);
+        lock_guard<mutex> lock(mtx);
+        ++miss_count;
+        map_t::iterator iter = entries.find(filename);
+        if (iter==entries.end()) {
+            if (entries.size()>=max_entries) {
+                entries.erase(lru.back());
+                lru.pop_back();
+            }
+            lru.push_front(filename);
+            entry_t e;
+            e.pos = lru.begin();
+            iter = entries.insert(make_pair(filename,e)).first;
+        }
+        else {
+            lru.splice(lru.begin(),lru,iter->second.pos);
+        }
+        iter->second.info = info;
+        iter->second.when = now;
+        iter->second.gen = generation;
+        return info;
+    };
+
+    //!
+    //! \brief mark every cached entry as stale
+    //!
+    void invalidate()
+    {
+        lock_guard<mutex> lock(mtx);
+        ++generation;
+    };
+
+    //!
+    //! \brief mark a single path as stale
+    //!
+    void invalidate(const string& filename)
+    {
+        lock_guard<mutex> lock(mtx);
+        map_t::iterator iter = entries.find(filename);
+        if (iter!=entries.end()) {
+            lru.erase(iter->second.pos);
+            entries.erase(iter);
+        }
+    };
+
+    size_t hits() const
+    {
+        lock_guard<mutex> lock(mtx);
+        return hit_count;
+    };
+    size_t misses() const
+    {
+        lock_guard<mutex> lock(mtx);
+        return miss_count;
+    };
+
+private:
+    struct entry_t {
+        FileInfo info;
+        double when;
+        unsigned long gen;
+        list<string>::iterator pos;
+    };
+    typedef unordered_map<string,entry_t> map_t;
+
+    size_t max_entries;
+    double max_age;
+    unsigned long generation;
+    size_t hit_count;
+    size_t miss_count;
+    mutable mutex mtx;
+    map_t entries;
+    list<string> lru;
+
+    static double clockNow()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC,&ts);
+        return ts.tv_sec + 1.e-9*ts.tv_nsec;
+    };
+};
+
+inline bool reportFileError(const char *who,const FileInfo& info)
+{
+    if (info.exists() || info.error()==ENOENT) return false;
+    string msg("FileInfo::");
+    msg += who;
+    msg += " error ";
+    msg += strerror(info.error());
+    cerr << msg << endl;
+    return false;
+}
+
+inline bool isRegularFile(const string& filename)
+{
+    FileInfo info(filename);
+    reportFileError("isRegularFile",info);
+    return info.isRegularFile();
 }
 
 inline bool isDirectory(const string& filename)
 {
-    struct stat64 fst;
-    errno = 0;
-    int e = stat64(filename.c_str(),&fst);
-    int ecode = errno;
-    if (e==-1) {
-        if (ecode == ENOENT) {
-            return false;
-        }
-        string msg("FileInfo::isDirectory error ");
-        msg += strerror(ecode);
-        cerr << msg << endl;
-        return false;
-    }
-    return S_ISDIR(fst.st_mode);
+    FileInfo info(filename);
+    reportFileError("isDirectory",info);
+    return info.isDirectory();
 }
 
 inline bool isLink(const string& filename)
 {
-    struct stat64 fst;
-    errno = 0;
-    int e = stat64(filename.c_str(),&fst);
-    int ecode = errno;
-    if (e==-1) {
-        if (ecode == ENOENT) {
-            return false;
-        }
-        string msg("FileInfo::isLink error ");
-        msg += strerror(ecode);
-        cerr << msg << endl;
-        return false;
-    }
-    return S_ISLNK(fst.st_mode);
+    FileInfo info(filename);
+    reportFileError("isLink",info);
+    return info.isLink();
 }
 
 inline bool canRead(const string& filename)
 {
-    struct stat64 fst;
-    errno = 0;
-    int e = stat64(filename.c_str(),&fst);
-    int ecode = errno;
-    if (e==-1) {
-        if (ecode == ENOENT) {
-            return false;
-        }
-        string msg("FileInfo::isRead error ");
-        msg += strerror(ecode);
-        cerr << msg << endl;
-        return false;
-    }
-    return bool( fst.st_mode & S_IRUSR);
+    FileInfo info(filename);
+    reportFileError("canRead",info);
+    return info.canRead();
 }
 
 inline bool canExecute(const string& filename)
 {
-    struct stat64 fst;
-    errno = 0;
-    int e = stat64(filename.c_str(),&fst);
-    int ecode = errno;
-    if (e==-1) {
-        if (ecode == ENOENT) {
-            return false;
-        }
-        string msg("FileInfo::canExecute error ");
-        msg += strerror(ecode);
-        cerr << msg << endl;
-        return false;
-    }
-    return bool( fst.st_mode & S_IXUSR);
+    FileInfo info(filename);
+    reportFileError("canExecute",info);
+    return info.canExecute();
 }
 
 inline bool canWrite(const string& filename)
 {
-    struct stat64 fst;
-    errno = 0;
-    int e = stat64(filename.c_str(),&fst);
-    int ecode = errno;
-    if (e==-1) {
-        if (ecode == ENOENT) {
-            return false;
-        }
-        string msg("FileInfo::canWrite error ");
-        msg += strerror(ecode);
-        cerr << msg << endl;
-        return false;
-    }
-    return bool( fst.st_mode & S_IWUSR);
+    FileInfo info(filename);
+    reportFileError("canWrite",info);
+    return info.canWrite();
 }
 
 
 inline size_t sizeOfFile(const string& filename)
 {
-    struct stat64 fst;
-    errno = 0;
-    int e = stat64(filename.c_str(),&fst);
-    int ecode = errno;
-    if (e==-1) {
-        if (ecode == ENOENT) {
-            return false;
+    FileInfo info(filename);
+    reportFileError("sizeOfFile",info);
+    return info.size();
+}
+
+//!
+//! \brief a read only memory mapping of a whole file. Throws a SystemError when it cannot be mapped.
+//!
+class MappedFile {
+public:
+    MappedFile(const string& filename):ptr(0),len(0)
+    {
+        errno = 0;
+        int fd = open(filename.c_str(),O_RDONLY|O_CLOEXEC);
+        if (fd==-1) throw SystemError(string("MappedFile could not open ")+filename,errno);
+        struct stat64 fst;
+        if (fstat64(fd,&fst)==-1) {
+            int e = errno;
+            close(fd);
+            throw SystemError(string("MappedFile could not stat ")+filename,e);
         }
-        string msg("FileInfo::sizeofOfFile error ");
-        msg += strerror(ecode);
-        cerr << msg << endl;
-        return false;
-    }
-    return fst.st_size;
+        len = fst.st_size;
+        if (len) {
+            void *p = mmap(0,len,PROT_READ,MAP_PRIVATE,fd,0);
+            if (p==MAP_FAILED) {
+                int e = errno;
+                close(fd);
+                throw SystemError(string("MappedFile could not map ")+filename,e);
+            }
+            ptr = static_cast<const char*>(p);
+        }
+        close(fd);
+    };
+
+    virtual ~MappedFile()
+    {
+        if (ptr) munmap(const_cast<char*>(ptr),len);
+    };
+
+    const char *data() const throw()
+    {
+        return ptr;
+    };
+
+    size_t size() const throw()
+    {
+        return len;
+    };
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char *ptr;
+    size_t len;
+};
+
+namespace detail {
+
+//!
+//! \brief throw a SystemError describing a failed copy
+//!
+inline void copyError(const char *what,const string& inputFile,const string& outputFile,int ecode)
+{
+    string err_msg("FileInfo::copyFileToFile ");
+    err_msg += what;
+    err_msg += " copying ";
+    err_msg += inputFile;
+    err_msg += " to ";
+    err_msg += outputFile;
+    throw SystemError(err_msg,ecode);
 }
 
-inline void copyFileToFile(const string& inputFile,const string& outputFile)
+//!
+//! \brief true when the error only means this copy method is not supported between these files
+//!
+inline bool copyUnsupported(int ecode)
 {
-    try {
-        ofstream out(inputFile.c_str());
-        ifstream in(outputFile.c_str());
-        out << in.rdbuf();
-        out.close();
-        in.close();
-    } catch (exception& e) {
-        string err_msg("FileInfo::copyFileToFile error copying ");
-        err_msg += inputFile;
-        err_msg += " to ";
-        err_msg += outputFile;
-        err_msg +=" ";
-        err_msg += e.what();
-        throw runtime_error(err_msg);
-    }
+    return ecode==EXDEV || ecode==EINVAL || ecode==ENOSYS || ecode==EOPNOTSUPP || ecode==ENOTTY || ecode==EBADF;
 }
 
+}
+
+//!
+//! \brief copy the contents of inputFile to outputFile, creating or truncating outputFile.
+//!
+//!  The copy is left to the kernel where possible: a reflink (FICLONE) which shares the data blocks,
+//!  then copy_file_range, then sendfile, and only then a read/write loop with a large buffer. When
+//!  preserve is true the permissions and access/modification times of inputFile are applied to
+//!  outputFile. Failures throw a SystemError naming the operation which failed. Copying a file onto
+//!  itself, under any name, is refused before anything is truncated.
+//!
+inline void copyFileToFile(const string& inputFile,const string& outputFile,bool preserve=false)
+{
+    errno = 0;
+    int in = open(inputFile.c_str(),O_RDONLY|O_CLOEXEC);
+    if (in==-1) detail::copyError("open failed",inputFile,outputFile,errno);
+    struct stat64 fst;
+    if (fstat64(in,&fst)==-1) {
+        int e = errno;
+        close(in);
+        detail::copyError("stat failed",inputFile,outputFile,e);
+    }
+    // truncated only once it is known not to be the input
+    int out = open(outputFile.c_str(),O_WRONLY|O_CREAT|O_CLOEXEC,fst.st_mode & 07777);
+    if (out==-1) {
+        int e = errno;
+        close(in);
+        detail::copyError("create failed",inputFile,outputFile,e);
+    }
+    struct stat64 ost;
+    const char *what = 0;
+    int ecode = 0;
+    if (fstat64(out,&ost)==-1) {
+        what = "stat of the output failed";
+        ecode = errno;
+    }
+    else if (ost.st_dev==fst.st_dev && ost.st_ino==fst.st_ino) {
+        what = "refused, the input and output are the same file,";
+        ecode = EINVAL;
+    }
+    else if (S_ISREG(ost.st_mode) && ftruncate64(out,0)==-1) {
+        what = "truncate failed";
+        ecode = errno;
+    }
+    if (ecode) {
+        close(in);
+        close(out);
+        detail::copyError(what,inputFile,outputFile,ecode);
+    }
+    bool done = false;
+#ifdef FICLONE
+    if (ioctl(out,FICLONE,in)==0) done = true;
+#endif
+    off64_t remaining = fst.st_size;
+    if (!done && S_ISREG(fst.st_mode) && remaining>0) {
+        const char *method = "copy_file_range failed";
+        // copy_file_range and sendfile need a size; both may copy less than asked
+        bool use_range = true;
+        bool use_sendfile = true;
+        while (remaining>0) {
+            ssize_t n = -1;
+            if (use_range) {
+                n = copy_file_range(in,0,out,0,remaining,0);
+                if (n==-1 && detail::copyUnsupported(errno) && remaining==fst.st_size) {
+                    use_range = false;
+                    continue;
+                }
+            }
+            else if (use_sendfile) {
+                method = "sendfile failed";
+                n = sendfile64(out,in,0,remaining);
+                if (n==-1 && detail::copyUnsupported(errno) && remaining==fst.st_size) {
+                    use_sendfile = false;
+                    break;
+                }
+            }
+            else {
+                break;
+            }
+            if (n==-1) {
+                if (errno==EINTR) continue;
+                what = method;
+                ecode = errno;
+                break;
+            }
+            if (n==0) break;
+            remaining -= n;
+        }
+        done = (remaining==0 && (use_range || use_sendfile));
+    }
+    if (!done && !ecode) {
+        // generic fallback, also used for special files whose size is not known
+        size_t bufsize = 4*1024*1024;
+        char *buf = static_cast<char*>(Malloc(bufsize));
+        for (;;) {
+            ssize_t n = read(in,buf,bufsize);
+            if (n==-1) {
+                if (errno==EINTR) continue;
+                what = "read failed";
+                ecode = errno;
+                break;
+            }
+            if (n==0) break;
+            for (ssize_t w=0; w<n;) {
+                ssize_t m = write(out,buf+w,n-w);
+                if (m==-1) {
+                    if (errno==EINTR) continue;
+                    what = "write failed";
+                    ecode = errno;
+                    break;
+                }
+                w += m;
+            }
+            if (ecode) break;
+        }
+        free(buf);
+    }
+    if (!ecode && preserve) {
+        struct timespec times[2];
+        times[0] = fst.st_atim;
+        times[1] = fst.st_mtim;
+        if (fchmod(out,fst.st_mode & 07777)==-1) {
+            what = "setting the permissions failed";
+            ecode = errno;
+        }
+        else if (futimens(out,times)==-1) {
+            what = "setting the times failed";
+            ecode = errno;
+        }
+    }
+    close(in);
+    if (close(out)==-1 && !ecode) {
+        what = "close failed";
+        ecode = errno;
+    }
+    if (ecode) detail::copyError(what,inputFile,outputFile,ecode);
+}
 }
 #endif
@@ -0,0 +1,159 @@
+/*
+ * Fingerprint.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef FINGERPRINT_HPP_
+#define FINGERPRINT_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <iostream>
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief a 128 bit hash value.
+//!
+//!  Fingerprints of the members of a set are combined by adding them, with the carry, so the
+//!  fingerprint of a set does not depend on the order of its members and a member can be taken out
+//!  again by subtracting its fingerprint.
+//!
+struct Fingerprint {
+    uint64_t lo;
+    uint64_t hi;
+
+    Fingerprint():lo(0),hi(0) {};
+    Fingerprint(uint64_t lo_in,uint64_t hi_in):lo(lo_in),hi(hi_in) {};
+
+    Fingerprint& operator+=(const Fingerprint& f) throw ()
+    {
+        uint64_t l = lo+f.lo;
+        hi += f.hi+(l<lo);
+        lo = l;
+        return *this;
+    };
+
+    Fingerprint& operator-=(const Fingerprint& f) throw ()
+    {
+        uint64_t l = lo-f.lo;
+        hi -= f.hi+(l>lo);
+        lo = l;
+        return *this;
+    };
+
+    bool operator==(const Fingerprint& f) const throw ()
+    {
+        return lo==f.lo && hi==f.hi;
+    };
+
+    bool operator!=(const Fingerprint& f) const throw ()
+    {
+        return lo!=f.lo || hi!=f.hi;
+    };
+
+    bool operator<(const Fingerprint& f) const throw ()
+    {
+        return hi<f.hi || (hi==f.hi && lo<f.lo);
+    };
+
+    //!
+    //! \brief the 32 hexadecimal digits, high half first
+    //!
+    string str() const
+    {
+        static const char hex[] = "0123456789abcdef";
+        string s(32,'0');
+        for (int k=0; k<16; ++k) {
+            s[15-k] = hex[(hi>>(4*k))&0xf];
+            s[31-k] = hex[(lo>>(4*k))&0xf];
+        }
+        return s;
+    };
+
+    static uint64_t rotl(uint64_t x,int r) throw ()
+    {
+        return (x<<r)|(x>>(64-r));
+    };
+
+    static uint64_t mix(uint64_t k) throw ()
+    {
+        k ^= k>>33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k>>33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k>>33;
+        return k;
+    };
+
+    //!
+    //! \brief the fingerprint of n bytes, MurmurHash3 x64 128
+    //!
+    static Fingerprint of(const void *data,size_t n,uint64_t seed=0) throw ()
+    {
+        const unsigned char *p = static_cast<const unsigned char*>(data);
+        const uint64_t c1 = 0x87c37b91114253d5ULL;
+        const uint64_t c2 = 0x4cf5ad432745937fULL;
+        uint64_t h1 = seed;
+        uint64_t h2 = seed;
+        size_t nblocks = n/16;
+        for (size_t b=0; b<nblocks; ++b) {
+            uint64_t k1;
+            uint64_t k2;
+            memcpy(&k1,p+16*b,8);
+            memcpy(&k2,p+16*b+8,8);
+            k1 *= c1;
+            k1 = rotl(k1,31);
+            k1 *= c2;
+            h1 ^= k1;
+            h1 = rotl(h1,27);
+            h1 += h2;
+            h1 = h1*5+0x52dce729;
+            k2 *= c2;
+            k2 = rotl(k2,33);
+            k2 *= c1;
+            h2 ^= k2;
+            h2 = rotl(h2,31);
+            h2 += h1;
+            h2 = h2*5+0x38495ab5;
+        }
+        const unsigned char *tail = p+16*nblocks;
+        uint64_t k1 = 0;
+        uint64_t k2 = 0;
+        size_t rest = n&15;
+        for (size_t j=rest; j>8; --j) k2 ^= uint64_t(tail[j-1])<<(8*(j-9));
+        for (size_t j=(rest<8) ? rest:8; j>0; --j) k1 ^= uint64_t(tail[j-1])<<(8*(j-1));
+        if (rest>8) {
+            k2 *= c2;
+            k2 = rotl(k2,33);
+            k2 *= c1;
+            h2 ^= k2;
+        }
+        if (rest) {
+            k1 *= c1;
+            k1 = rotl(k1,31);
+            k1 *= c2;
+            h1 ^= k1;
+        }
+        h1 ^= n;
+        h2 ^= n;
+        h1 += h2;
+        h2 += h1;
+        h1 = mix(h1);
+        h2 = mix(h2);
+        h1 += h2;
+        h2 += h1;
+        return Fingerprint(h1,h2);
+    };
+};
+
+inline ostream& operator<<(ostream& os,const Fingerprint& f)
+{
+    return os << f.str();
+}
+
+}
+#endif /* FINGERPRINT_HPP_ */
@@ -0,0 +1,326 @@
+/*
+ * LatencyHistogram.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef LATENCYHISTOGRAM_HPP_
+#define LATENCYHISTOGRAM_HPP_
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <iostream>
+using namespace std;
+
+namespace putils {
+
+class LatencyRecorder;
+
+//!
+//! \brief a histogram of times in nanoseconds with log-linear buckets in the style of HdrHistogram.
+//!
+//!  Times below 2*SUB_BUCKETS ns are counted exactly. Above that each power of two is split into
+//!  SUB_BUCKETS equal buckets, so a value is known to better than 1% (1/128). Times from 2^MAX_BITS
+//!  ns (about 4.9 hours) up are counted in the last bucket. The footprint is fixed at NBUCKETS
+//!  counters and recording is a few integer operations.
+//!
+class LatencyHistogram {
+public:
+    enum { SUB_BITS = 7, SUB_BUCKETS = 1<<SUB_BITS, MAX_BITS = 44, NBUCKETS = (MAX_BITS-SUB_BITS+1)*SUB_BUCKETS };
+
+    LatencyHistogram():counts(NBUCKETS,0),total_count(0),total_ns(0),min_ns(~0ULL),max_ns(0)
+    {
+    };
+
+    virtual ~LatencyHistogram()
+    {
+    };
+
+    //!
+    //! \brief the bucket counting a time of ns nanoseconds
+    //!
+    static size_t bucketOf(unsigned long long ns) throw ()
+    {
+        if (ns<2ULL*SUB_BUCKETS) return size_t(ns);
+        int msb = 63-__builtin_clzll(ns);
+        if (msb>=MAX_BITS) return NBUCKETS-1;
+        int shift = msb-SUB_BITS;
+        return size_t(shift)*SUB_BUCKETS+size_t(ns>>shift);
+    };
+
+    //!
+    //! \brief the smallest time counted in bucket b
+    //!
+    static unsigned long long bucketLow(size_t b) throw ()
+    {
+        if (b<2*size_t(SUB_BUCKETS)) return b;
+        size_t shift = b/SUB_BUCKETS-1;
+        return (unsigned long long)(b-shift*SUB_BUCKETS)<<shift;
+    };
+
+    //!
+    //! \brief the largest time counted in bucket b
+    //!
+    static unsigned long long bucketHigh(size_t b) throw ()
+    {
+        if (b<2*size_t(SUB_BUCKETS)) return b;
+        size_t shift = b/SUB_BUCKETS-1;
+        return bucketLow(b)+(1ULL<<shift)-1;
+    };
+
+    void record(unsigned long long ns) throw ()
+    {
+        ++counts[bucketOf(ns)];
+        ++total_count;
+        total_ns += ns;
+        if (ns<min_ns) min_ns = ns;
+        if (ns>max_ns) max_ns = ns;
+    };
+
+    //!
+    //! \brief add the counts of h to this histogram
+    //!
+    void merge(const LatencyHistogram& h)
+    {
+        for (size_t b=0; b<size_t(NBUCKETS); ++b) counts[b] += h.counts[b];
+        total_count += h.total_count;
+        total_ns += h.total_ns;
+        if (h.min_ns<min_ns) min_ns = h.min_ns;
+        if (h.max_ns>max_ns) max_ns = h.max_ns;
+    };
+
+    void clear()
+    {
+        counts.assign(NBUCKETS,0);
+        total_count = 0;
+        total_ns = 0;
+        min_ns = ~0ULL;
+        max_ns = 0;
+    };
+
+    unsigned long long count() const throw ()
+    {
+        return total_count;
+    };
+
+    unsigned long long minimum() const throw ()
+    {
+        return (total_count) ? min_ns:0;
+    };
+
+    unsigned long long maximum() const throw ()
+    {
+        return max_ns;
+    };
+
+    double mean() const throw ()
+    {
+        return (total_count) ? double(total_ns)/total_count:0.;
+    };
+
+    //!
+    //! \brief the time in nanoseconds which percent of the recorded times do not exceed, to the
+    //!  precision of the buckets (the top of the bucket holding it, never above the maximum)
+    //!
+    unsigned long long percentile(double percent) const throw ()
+    {
+        if (total_count==0) return 0;
+        if (percent>=100.) return max_ns;
+        unsigned long long rank = (unsigned long long)(percent/100.*total_count+0.5);
+        if (rank==0) rank = 1;
+        unsigned long long seen = 0;
+        for (size_t b=0; b<size_t(NBUCKETS); ++b) {
+            seen += counts[b];
+            if (seen>=rank) {
+                unsigned long long v = bucketHigh(b);
+                return (v<max_ns) ? v:max_ns;
+            }
+        }
+        return max_ns;
+    };
+
+    unsigned long long bucketCount(size_t b) const throw ()
+    {
+        return counts[b];
+    };
+
+    //!
+    //! \brief write the count, mean and the usual percentiles in microseconds
+    //!
+    ostream& writeText(ostream& os) const
+    {
+        static const double pcts[] = { 50., 90., 99., 99.9, 99.99 };
+        char line[128];
+        snprintf(line,sizeof(line),"count %llu mean %.3f us min %.3f us max %.3f us\n",
+                 total_count,1.e-3*mean(),1.e-3*minimum(),1.e-3*maximum());
+        os << line;
+        for (size_t k=0; k<sizeof(pcts)/sizeof(pcts[0]); ++k) {
+            snprintf(line,sizeof(line),"  p%-6g %12.3f us\n",pcts[k],1.e-3*percentile(pcts[k]));
+            os << line;
+        }
+        return os;
+    };
+
+    //!
+    //! \brief write one line per non empty bucket: its range in ns, its count and the fraction of
+    //!  the recorded times up to and including it
+    //!
+    ostream& writeCsv(ostream& os) const
+    {
+        os << "low_ns,high_ns,count,cumulative\n";
+        unsigned long long seen = 0;
+        char line[128];
+        for (size_t b=0; b<size_t(NBUCKETS); ++b) {
+            if (!counts[b]) continue;
+            seen += counts[b];
+            snprintf(line,sizeof(line),"%llu,%llu,%llu,%.6f\n",bucketLow(b),bucketHigh(b),counts[b],
+                     double(seen)/total_count);
+            os << line;
+        }
+        return os;
+    };
+
+private:
+    friend class LatencyRecorder;
+    vector<unsigned long long> counts;
+    unsigned long long total_count;
+    unsigned long long total_ns;
+    unsigned long long min_ns;
+    unsigned long long max_ns;
+};
+
+//!
+//! \brief a histogram written by one thread and read by any.
+//!
+//!  Only the owning thread records, with relaxed loads and stores rather than locked instructions,
+//!  so recording costs the same as in a LatencyHistogram. Other threads may copy the counts into a
+//!  LatencyHistogram at any time; a copy taken while recording may miss the latest times.
+//!
+class LatencyRecorder {
+public:
+    LatencyRecorder():counts(new atomic<unsigned long long>[LatencyHistogram::NBUCKETS]),total_ns(0),min_ns(~0ULL),max_ns(0)
+    {
+        for (size_t b=0; b<size_t(LatencyHistogram::NBUCKETS); ++b) counts[b].store(0,memory_order_relaxed);
+    };
+
+    virtual ~LatencyRecorder()
+    {
+    };
+
+    void record(unsigned long long ns) throw ()
+    {
+        atomic<unsigned long long>& c = counts[LatencyHistogram::bucketOf(ns)];
+        c.store(c.load(memory_order_relaxed)+1,memory_order_relaxed);
+        total_ns.store(total_ns.load(memory_order_relaxed)+ns,memory_order_relaxed);
+        if (ns<min_ns.load(memory_order_relaxed)) min_ns.store(ns,memory_order_relaxed);
+        if (ns>max_ns.load(memory_order_relaxed)) max_ns.store(ns,memory_order_relaxed);
+    };
+
+    //!
+    //! \brief add the counts recorded so far to h
+    //!
+    void addTo(LatencyHistogram& h) const
+    {
+        for (size_t b=0; b<size_t(LatencyHistogram::NBUCKETS); ++b) {
+            unsigned long long n = counts[b].load(memory_order_relaxed);
+            h.counts[b] += n;
+            h.total_count += n;
+        }
+        h.total_ns += total_ns.load(memory_order_relaxed);
+        unsigned long long lo = min_ns.load(memory_order_relaxed);
+        unsigned long long hi = max_ns.load(memory_order_relaxed);
+        if (lo<h.min_ns) h.min_ns = lo;
+        if (hi>h.max_ns) h.max_ns = hi;
+    };
+
+private:
+    LatencyRecorder(const LatencyRecorder&);
+    LatencyRecorder& operator=(const LatencyRecorder&);
+
+    unique_ptr< atomic<unsigned long long>[] > counts;
+    atomic<unsigned long long> total_ns;
+    atomic<unsigned long long> min_ns;
+    atomic<unsigned long long> max_ns;
+};
+
+//!
+//! \brief times an operation repeated across threads.
+//!
+//!  Each thread records into its own LatencyRecorder, taken once with recorder() and kept by the
+//!  thread; snapshot() merges them all. ScopedLatency times a block into a recorder.
+//!
+class LatencyTimer {
+public:
+    LatencyTimer()
+    {
+    };
+
+    virtual ~LatencyTimer()
+    {
+    };
+
+    //!
+    //! \brief a new recorder for the calling thread, owned by the timer
+    //!
+    LatencyRecorder& recorder()
+    {
+        lock_guard<mutex> lock(mtx);
+        recorders.push_back(shared_ptr<LatencyRecorder>(new LatencyRecorder));
+        return *recorders.back();
+    };
+
+    //!
+    //! \brief the times recorded so far by every recorder
+    //!
+    LatencyHistogram snapshot() const
+    {
+        LatencyHistogram h;
+        lock_guard<mutex> lock(mtx);
+        for (size_t k=0; k<recorders.size(); ++k) recorders[k]->addTo(h);
+        return h;
+    };
+
+    static unsigned long long now() throw ()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC,&ts);
+        return ts.tv_sec*1000000000ULL+ts.tv_nsec;
+    };
+
+private:
+    LatencyTimer(const LatencyTimer&);
+    LatencyTimer& operator=(const LatencyTimer&);
+
+    mutable mutex mtx;
+    vector< shared_ptr<LatencyRecorder> > recorders;
+};
+
+//!
+//! \brief records the time from construction to destruction in a recorder
+//!
+class ScopedLatency {
+public:
+    explicit ScopedLatency(LatencyRecorder& rec_in) throw ():rec(rec_in),start(LatencyTimer::now())
+    {
+    };
+
+    ~ScopedLatency()
+    {
+        rec.record(LatencyTimer::now()-start);
+    };
+
+private:
+    ScopedLatency(const ScopedLatency&);
+    ScopedLatency& operator=(const ScopedLatency&);
+
+    LatencyRecorder& rec;
+    unsigned long long start;
+};
+
+}
+#endif /* LATENCYHISTOGRAM_HPP_ */
@@ -0,0 +1,384 @@
+/*
+ * OptionTokenizer.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef OPTIONTOKENIZER_HPP_
+#define OPTIONTOKENIZER_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "putils.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief a name or value as it appears in option file text, quotes included. begin is null for a
+//!  missing value. escaped is set when the text holds escapes or continued lines and so must be
+//!  decoded; otherwise it can be used in place.
+//!
+struct OptionToken {
+    const char *begin;
+    const char *end;
+    bool escaped;
+
+    OptionToken():begin(0),end(0),escaped(false) {};
+
+    bool present() const throw ()
+    {
+        return begin!=0;
+    };
+};
+
+//!
+//! \brief splits option file text into names and values in one pass, driven by a state table.
+//!
+//!  Each line holds a name optionally followed by a value, separated by blanks or '='. Text after
+//!  the value is ignored. A name or value is either bare, running to the next blank, '=' or line
+//!  break, or quoted: "..." allows the escapes \n \r \t \f and a backslash before any other
+//!  character stands for it, while '...' is taken literally. Lines starting with !, # or [ and
+//!  text from a # starting a word are comments, blank lines are skipped and a backslash ending a
+//!  line joins the next one to it. Tokens are returned as the text they cover, so only those with
+//!  escapes or continued lines need to be copied.
+//!
+class OptionTokenizer {
+public:
+    //!
+    //! \brief call f(name,value,line) for each option in [data,data+len), value not present when
+    //!  the line gives none, and on_error(message,line) for each malformed line, after which the
+    //!  next line is read
+    //!
+    template<class F,class E>
+    static void forEachOption(const char *data,size_t len,F f,E on_error)
+    {
+        const unsigned char *cls = classTable();
+        const unsigned char (&next_of)[NSTATES][NCLASSES] = transitions();
+        const char *p = data;
+        const char *end = data+len;
+        size_t line = 1;
+        size_t name_line = 0;
+        bool in_value = false;
+        OptionToken name;
+        OptionToken tok;
+        int state = S_LINE;
+        while (p<end) {
+            if (state==S_BARE) {
+                // most bytes are inside names and values, move over them without a transition
+                while (p<end && ((BARE_CLASSES>>cls[static_cast<unsigned char>(*p)])&1)) ++p;
+                if (p==end) break;
+            }
+            else if (state==S_COMMENT) {
+                // a comment runs to the line break, backslashes and all
+                const char *nl = static_cast<const char*>(memchr(p,'\n',end-p));
+                if (!nl) break;
+                p = nl;
+            }
+            unsigned char t = next_of[state][cls[static_cast<unsigned char>(*p)]];
+            int next = t&0xf;
+            switch (t>>4) {
+            case A_NONE:
+                break;
+            case A_NEWLINE:
+                ++line;
+                break;
+            case A_BEGIN:
+                tok.begin = p;
+                tok.escaped = false;
+                if (!in_value) name_line = line;
+                break;
+            case A_BEGIN_BSL:
+                // the backslash starts a bare word, read the character after it again
+                tok.begin = p-1;
+                tok.escaped = false;
+                if (!in_value) name_line = line;
+                state = S_BARE;
+                continue;
+            case A_LITERAL_BSL:
+                state = S_BARE;
+                continue;
+            case A_ESCAPE:
+                tok.escaped = true;
+                break;
+            case A_CONTINUE:
+                tok.escaped = true;
+                ++line;
+                break;
+            case A_END_QUOTE:
+                tok.end = p+1;
+                next = endToken(f,name,tok,name_line,in_value);
+                break;
+            case A_END:
+                tok.end = p;
+                next = endToken(f,name,tok,name_line,in_value);
+                break;
+            case A_END_LINE:
+                tok.end = p;
+                endToken(f,name,tok,name_line,in_value);
+                if (in_value) {
+                    f(name,OptionToken(),name_line);
+                    in_value = false;
+                }
+                ++line;
+                break;
+            case A_NO_VALUE:
+                f(name,OptionToken(),name_line);
+                in_value = false;
+                if (next==S_LINE) ++line;
+                break;
+            case A_NO_NAME:
+                on_error("no option name found in option input file",line);
+                break;
+            case A_UNTERMINATED:
+                on_error("unterminated quoted value in option input file",line);
+                in_value = false;
+                ++line;
+                break;
+            }
+            state = next;
+            ++p;
+        }
+        switch (state) {
+        case S_BARE:
+        case S_BARE_BSL:
+            tok.end = end;
+            endToken(f,name,tok,name_line,in_value);
+            if (in_value) f(name,OptionToken(),name_line);
+            break;
+        case S_SEP:
+        case S_SEP_BSL:
+            f(name,OptionToken(),name_line);
+            break;
+        case S_DQ:
+        case S_DQ_ESC:
+        case S_SQ:
+            on_error("unterminated quoted value in option input file",line);
+            break;
+        }
+    };
+
+    //!
+    //! \brief throw the ParseError forEachOption(data,len,f) reports for message at line
+    //!
+    static void throwError(const char *message,size_t line)
+    {
+        string err(message);
+        err += " at line ";
+        err += type2string(line);
+        err += "\n";
+        throw ParseError(err);
+    };
+
+    //!
+    //! \brief as forEachOption(data,len,f,on_error), throwing a ParseError for a malformed line
+    //!
+    template<class F>
+    static void forEachOption(const char *data,size_t len,F f)
+    {
+        forEachOption(data,len,f,throwError);
+    };
+
+    //!
+    //! \brief the text of tok as pointer and length, in place unless it has to be decoded into
+    //!  scratch. A missing value reads true.
+    //!
+    static void view(const OptionToken& tok,string& scratch,const char *& p,size_t& n)
+    {
+        if (!tok.present()) {
+            p = "true";
+            n = 4;
+        }
+        else if (tok.escaped) {
+            decode(tok,scratch);
+            p = scratch.data();
+            n = scratch.size();
+        }
+        else if (*tok.begin=='"' || *tok.begin=='\'') {
+            p = tok.begin+1;
+            n = tok.end-tok.begin-2;
+        }
+        else {
+            p = tok.begin;
+            n = tok.end-tok.begin;
+        }
+    };
+
+    //!
+    //! \brief the text of tok as a string, true for a missing value
+    //!
+    static string text(const OptionToken& tok)
+    {
+        string scratch;
+        const char *p;
+        size_t n;
+        view(tok,scratch,p,n);
+        if (p==scratch.data()) return scratch;
+        return string(p,n);
+    };
+
+    //!
+    //! \brief whether text may be split before offset pos for its parts to be tokenized apart:
+    //!  pos must follow a line break which no backslash continues
+    //!
+    static bool isLineStart(const char *data,size_t pos) throw ()
+    {
+        if (pos==0) return true;
+        if (data[pos-1]!='\n') return false;
+        return pos<2 || data[pos-2]!='\\';
+    };
+
+private:
+    enum { C_OTHER, C_BLANK, C_EQ, C_NL, C_HASH, C_MARK, C_DQ, C_SQ, C_BSL, NCLASSES };
+    enum { S_LINE, S_SEP, S_TAIL, S_COMMENT, S_BARE, S_DQ, S_DQ_ESC, S_SQ, S_LINE_BSL, S_SEP_BSL, S_TAIL_BSL,
+           S_BARE_BSL, NSTATES };
+    // the classes which leave a bare word going on
+    enum { BARE_CLASSES = (1<<C_OTHER)|(1<<C_HASH)|(1<<C_MARK)|(1<<C_DQ)|(1<<C_SQ) };
+    enum { A_NONE, A_NEWLINE, A_BEGIN, A_BEGIN_BSL, A_LITERAL_BSL, A_ESCAPE, A_CONTINUE, A_END, A_END_QUOTE,
+           A_END_LINE, A_NO_VALUE, A_NO_NAME, A_UNTERMINATED };
+
+    //!
+    //! \brief the next state and action for each state and character class, in the class order
+    //!  other, blank, '=', line break, '#', '!' or '[', '"', '\'' and backslash. The state after a
+    //!  finished token is chosen by endToken.
+    //!
+    static const unsigned char (&transitions())[NSTATES][NCLASSES]
+    {
+#define PUTILS_TOK(state,action) static_cast<unsigned char>((action<<4)|state)
+        static const unsigned char table[NSTATES][NCLASSES] = {
+        // S_LINE
+        { PUTILS_TOK(S_BARE,A_BEGIN), PUTILS_TOK(S_LINE,A_NONE), PUTILS_TOK(S_COMMENT,A_NO_NAME),
+          PUTILS_TOK(S_LINE,A_NEWLINE), PUTILS_TOK(S_COMMENT,A_NONE), PUTILS_TOK(S_COMMENT,A_NONE),
+          PUTILS_TOK(S_DQ,A_BEGIN), PUTILS_TOK(S_SQ,A_BEGIN), PUTILS_TOK(S_LINE_BSL,A_NONE) },
+        // S_SEP
+        { PUTILS_TOK(S_BARE,A_BEGIN), PUTILS_TOK(S_SEP,A_NONE), PUTILS_TOK(S_SEP,A_NONE),
+          PUTILS_TOK(S_LINE,A_NO_VALUE), PUTILS_TOK(S_COMMENT,A_NO_VALUE), PUTILS_TOK(S_BARE,A_BEGIN),
+          PUTILS_TOK(S_DQ,A_BEGIN), PUTILS_TOK(S_SQ,A_BEGIN), PUTILS_TOK(S_SEP_BSL,A_NONE) },
+        // S_TAIL
+        { PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL,A_NONE),
+          PUTILS_TOK(S_LINE,A_NEWLINE), PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL,A_NONE),
+          PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL_BSL,A_NONE) },
+        // S_COMMENT
+        { PUTILS_TOK(S_COMMENT,A_NONE), PUTILS_TOK(S_COMMENT,A_NONE), PUTILS_TOK(S_COMMENT,A_NONE),
+          PUTILS_TOK(S_LINE,A_NEWLINE), PUTILS_TOK(S_COMMENT,A_NONE), PUTILS_TOK(S_COMMENT,A_NONE),
+          PUTILS_TOK(S_COMMENT,A_NONE), PUTILS_TOK(S_COMMENT,A_NONE), PUTILS_TOK(S_COMMENT,A_NONE) },
+        // S_BARE
+        { PUTILS_TOK(S_BARE,A_NONE), PUTILS_TOK(S_SEP,A_END), PUTILS_TOK(S_SEP,A_END),
+          PUTILS_TOK(S_LINE,A_END_LINE), PUTILS_TOK(S_BARE,A_NONE), PUTILS_TOK(S_BARE,A_NONE),
+          PUTILS_TOK(S_BARE,A_NONE), PUTILS_TOK(S_BARE,A_NONE), PUTILS_TOK(S_BARE_BSL,A_NONE) },
+        // S_DQ
+        { PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ,A_NONE),
+          PUTILS_TOK(S_LINE,A_UNTERMINATED), PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ,A_NONE),
+          PUTILS_TOK(S_SEP,A_END_QUOTE), PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ_ESC,A_ESCAPE) },
+        // S_DQ_ESC
+        { PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ,A_NONE),
+          PUTILS_TOK(S_DQ,A_CONTINUE), PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ,A_NONE),
+          PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ,A_NONE), PUTILS_TOK(S_DQ,A_NONE) },
+        // S_SQ
+        { PUTILS_TOK(S_SQ,A_NONE), PUTILS_TOK(S_SQ,A_NONE), PUTILS_TOK(S_SQ,A_NONE),
+          PUTILS_TOK(S_LINE,A_UNTERMINATED), PUTILS_TOK(S_SQ,A_NONE), PUTILS_TOK(S_SQ,A_NONE),
+          PUTILS_TOK(S_SQ,A_NONE), PUTILS_TOK(S_SEP,A_END_QUOTE), PUTILS_TOK(S_SQ,A_NONE) },
+        // S_LINE_BSL
+        { PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL),
+          PUTILS_TOK(S_LINE,A_NEWLINE), PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL),
+          PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL) },
+        // S_SEP_BSL
+        { PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL),
+          PUTILS_TOK(S_SEP,A_NEWLINE), PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL),
+          PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL), PUTILS_TOK(S_BARE,A_BEGIN_BSL) },
+        // S_TAIL_BSL
+        { PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL,A_NONE),
+          PUTILS_TOK(S_TAIL,A_NEWLINE), PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL,A_NONE),
+          PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL,A_NONE), PUTILS_TOK(S_TAIL_BSL,A_NONE) },
+        // S_BARE_BSL
+        { PUTILS_TOK(S_BARE,A_LITERAL_BSL), PUTILS_TOK(S_BARE,A_LITERAL_BSL), PUTILS_TOK(S_BARE,A_LITERAL_BSL),
+          PUTILS_TOK(S_BARE,A_CONTINUE), PUTILS_TOK(S_BARE,A_LITERAL_BSL), PUTILS_TOK(S_BARE,A_LITERAL_BSL),
+          PUTILS_TOK(S_BARE,A_LITERAL_BSL), PUTILS_TOK(S_BARE,A_LITERAL_BSL), PUTILS_TOK(S_BARE_BSL,A_NONE) }
+};
+#undef PUTILS_TOK
+        return table;
+    };
+
+    static const unsigned char *classTable()
+    {
+        struct table_t {
+            unsigned char c[256];
+            table_t()
+            {
+                memset(c,C_OTHER,sizeof(c));
+                c[static_cast<unsigned char>(' ')] = C_BLANK;
+                c[static_cast<unsigned char>('\t')] = C_BLANK;
+                c[static_cast<unsigned char>('\r')] = C_BLANK;
+                c[static_cast<unsigned char>('\f')] = C_BLANK;
+                c[static_cast<unsigned char>('=')] = C_EQ;
+                c[static_cast<unsigned char>('\n')] = C_NL;
+                c[static_cast<unsigned char>('#')] = C_HASH;
+                c[static_cast<unsigned char>('!')] = C_MARK;
+                c[static_cast<unsigned char>('[')] = C_MARK;
+                c[static_cast<unsigned char>('"')] = C_DQ;
+                c[static_cast<unsigned char>('\'')] = C_SQ;
+                c[static_cast<unsigned char>('\\')] = C_BSL;
+            };
+        };
+        static const table_t table;
+        return table.c;
+    };
+
+    //!
+    //! \brief a finished name is kept until its value is found, a finished value is passed on with
+    //!  its name. Returns the state to read on in.
+    //!
+    template<class F>
+    static int endToken(F& f,OptionToken& name,const OptionToken& tok,size_t name_line,bool& in_value)
+    {
+        if (!in_value) {
+            name = tok;
+            in_value = true;
+            return S_SEP;
+        }
+        f(name,tok,name_line);
+        in_value = false;
+        return S_TAIL;
+    };
+
+    static void decode(const OptionToken& tok,string& out)
+    {
+        out.clear();
+        const char *p = tok.begin;
+        const char *e = tok.end;
+        if (*p=='"') {
+            for (++p, --e; p<e; ++p) {
+                if (*p!='\\') {
+                    out.push_back(*p);
+                    continue;
+                }
+                switch (*++p) {
+                case 'n':
+                    out.push_back('\n');
+                    break;
+                case 'r':
+                    out.push_back('\r');
+                    break;
+                case 't':
+                    out.push_back('\t');
+                    break;
+                case 'f':
+                    out.push_back('\f');
+                    break;
+                case '\n':
+                    break;
+                default:
+                    out.push_back(*p);
+                }
+            }
+            return;
+        }
+        for (; p<e; ++p) {
+            if (*p=='\\' && p+1<e && p[1]=='\n') ++p;
+            else out.push_back(*p);
+        }
+    };
+};
+
+}
+#endif /* OPTIONTOKENIZER_HPP_ */
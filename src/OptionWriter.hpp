@@ -0,0 +1,310 @@
+/*
+ * OptionWriter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef OPTIONWRITER_HPP_
+#define OPTIONWRITER_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <iostream>
+extern "C" {
+#include <fcntl.h>
+}
+#include <unistd.h>
+#include "putils.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief a growable character buffer which is written out in one go.
+//!
+//!  Serializers append to the buffer and nothing reaches the file or stream until writeTo, which
+//!  issues a single write (repeated only if the kernel takes less than all of it).
+//!
+class OutputBuffer {
+public:
+    OutputBuffer(size_t initial_capacity=4096):buf()
+    {
+        buf.reserve(initial_capacity);
+    };
+
+    virtual ~OutputBuffer()
+    {
+    };
+
+    void append(const char *s,size_t n)
+    {
+        buf.append(s,n);
+    };
+
+    void append(const string& s)
+    {
+        buf.append(s);
+    };
+
+    void append(char ch)
+    {
+        buf.push_back(ch);
+    };
+
+    //!
+    //! \brief append the decimal digits of v
+    //!
+    void appendUnsigned(unsigned long long v)
+    {
+        char digits[24];
+        char *p = digits+sizeof(digits);
+        do {
+            *--p = char('0'+v%10);
+            v /= 10;
+        } while (v);
+        buf.append(p,digits+sizeof(digits)-p);
+    };
+
+    //!
+    //! \brief append v as width lower case hex digits
+    //!
+    void appendHex(unsigned long v,int width)
+    {
+        static const char hex[] = "0123456789abcdef";
+        for (int s=4*(width-1); s>=0; s-=4) buf.push_back(hex[(v>>s)&0xf]);
+    };
+
+    const char *data() const throw ()
+    {
+        return buf.data();
+    };
+
+    size_t size() const throw ()
+    {
+        return buf.size();
+    };
+
+    void clear() throw ()
+    {
+        buf.clear();
+    };
+
+    const string& str() const throw ()
+    {
+        return buf;
+    };
+
+    //!
+    //! \brief write the whole buffer to fd
+    //!
+    void writeTo(int fd) const
+    {
+        const char *p = buf.data();
+        size_t left = buf.size();
+        while (left) {
+            ssize_t n = write(fd,p,left);
+            if (n<0) {
+                if (errno==EINTR) continue;
+                throw SystemError("OutputBuffer write",errno);
+            }
+            p += n;
+            left -= n;
+        }
+    };
+
+    //!
+    //! \brief replace the file filename with the contents of the buffer
+    //!
+    void writeTo(const string& filename) const
+    {
+        errno = 0;
+        int fd = open(filename.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0644);
+        if (fd==-1) throw SystemError(string("OutputBuffer could not open ")+filename,errno);
+        try {
+            writeTo(fd);
+        }
+        catch (...) {
+            close(fd);
+            throw;
+        }
+        if (close(fd)==-1) throw SystemError(string("OutputBuffer could not close ")+filename,errno);
+    };
+
+    ostream& writeTo(ostream& os) const
+    {
+        return os.write(buf.data(),buf.size());
+    };
+
+private:
+    string buf;
+};
+
+//!
+//! \brief append value to out as a JSON string, escaping only the characters JSON requires
+//!
+inline void appendJsonString(OutputBuffer& out,const string& value)
+{
+    const char *p = value.data();
+    const char *end = p+value.size();
+    out.append('"');
+    const char *run = p;
+    for (; p<end; ++p) {
+        unsigned char ch = *p;
+        if (ch>=0x20 && ch!='"' && ch!='\\') continue;
+        out.append(run,p-run);
+        run = p+1;
+        out.append('\\');
+        switch (ch) {
+        case '"':
+            out.append('"');
+            break;
+        case '\\':
+            out.append('\\');
+            break;
+        case '\n':
+            out.append('n');
+            break;
+        case '\t':
+            out.append('t');
+            break;
+        case '\r':
+            out.append('r');
+            break;
+        case '\b':
+            out.append('b');
+            break;
+        case '\f':
+            out.append('f');
+            break;
+        default:
+            out.append("u00",3);
+            out.appendHex(ch,2);
+        }
+    }
+    out.append(run,end-run);
+    out.append('"');
+}
+
+//!
+//! \brief true when value is written the same way as a JSON number, true or false, and so may be
+//!  exported without quotes and read back unchanged
+//!
+inline bool isJsonLiteral(const string& value) throw ()
+{
+    if (value=="true" || value=="false") return true;
+    const char *p = value.c_str();
+    if (*p=='-') ++p;
+    if (*p=='0') ++p;
+    else if (*p>='1' && *p<='9') {
+        while (*p>='0' && *p<='9') ++p;
+    }
+    else return false;
+    if (*p=='.') {
+        ++p;
+        if (!(*p>='0' && *p<='9')) return false;
+        while (*p>='0' && *p<='9') ++p;
+    }
+    if (*p=='e' || *p=='E') {
+        ++p;
+        if (*p=='+' || *p=='-') ++p;
+        if (!(*p>='0' && *p<='9')) return false;
+        while (*p>='0' && *p<='9') ++p;
+    }
+    return p==value.c_str()+value.size();
+}
+
+//!
+//! \brief append value to out as one shell word, quoted only if it holds characters the shell treats
+//!  specially
+//!
+inline void appendShellWord(OutputBuffer& out,const string& value)
+{
+    bool plain = value.size()!=0;
+    for (size_t k=0; plain && k<value.size(); ++k) {
+        char ch = value[k];
+        plain = isalnum(static_cast<unsigned char>(ch)) || strchr("_-+=.,:/@%^",ch);
+    }
+    if (plain) {
+        out.append(value);
+        return;
+    }
+    out.append('\'');
+    size_t run = 0;
+    for (size_t k=0; k<value.size(); ++k) {
+        if (value[k]!='\'') continue;
+        out.append(value.data()+run,k-run);
+        out.append("'\\''",4);
+        run = k+1;
+    }
+    out.append(value.data()+run,value.size()-run);
+    out.append('\'');
+}
+
+//!
+//! \brief true when name is a valid shell variable name
+//!
+inline bool isShellName(const string& name) throw ()
+{
+    if (name.empty() || isdigit(static_cast<unsigned char>(name[0]))) return false;
+    for (size_t k=0; k<name.size(); ++k) {
+        char ch = name[k];
+        if (!isalnum(static_cast<unsigned char>(ch)) && ch!='_') return false;
+    }
+    return true;
+}
+
+//!
+//! \brief append value to out as an option file value. Values which are empty, start with a quote
+//!  or '#', or hold a blank, '=', backslash or line break are written in double quotes with
+//!  backslash escapes. An empty value is written as "" since a name alone reads back as true.
+//!
+inline void appendOptionValue(OutputBuffer& out,const string& value)
+{
+    bool plain = value.size()!=0 && value[0]!='"' && value[0]!='\'' && value[0]!='#';
+    for (size_t k=0; plain && k<value.size(); ++k) {
+        char ch = value[k];
+        plain = !(ch==' ' || ch=='=' || ch=='\\' || ch=='\t' || ch=='\n' || ch=='\r' || ch=='\f');
+    }
+    if (plain) {
+        out.append(value);
+        return;
+    }
+    out.append('"');
+    size_t run = 0;
+    for (size_t k=0; k<value.size(); ++k) {
+        char ch = value[k];
+        char esc;
+        switch (ch) {
+        case '"':
+            esc = '"';
+            break;
+        case '\\':
+            esc = '\\';
+            break;
+        case '\n':
+            esc = 'n';
+            break;
+        case '\r':
+            esc = 'r';
+            break;
+        case '\t':
+            esc = 't';
+            break;
+        case '\f':
+            esc = 'f';
+            break;
+        default:
+            continue;
+        }
+        out.append(value.data()+run,k-run);
+        out.append('\\');
+        out.append(esc);
+        run = k+1;
+    }
+    out.append(value.data()+run,value.size()-run);
+    out.append('"');
+}
+
+}
+#endif /* OPTIONWRITER_HPP_ */
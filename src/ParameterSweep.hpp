@@ -0,0 +1,336 @@
+/*
+ * ParameterSweep.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef PARAMETERSWEEP_HPP_
+#define PARAMETERSWEEP_HPP_
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <unordered_map>
+#include "putils.hpp"
+#include "ProgramOptions.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief the values one swept option takes, computed when asked for.
+//!
+//!  A list is written {a,b,c}. A range is written start:stop:step for start, start+step, ... up to
+//!  stop, or start:stop:logB for start, start*B, start*B^2, ... up to stop (e.g. 1e-3:1e-1:log10).
+//!
+class SweepAxis {
+public:
+    //!
+    //! \brief parse value as a list or range. Returns false, leaving the axis alone, for a plain
+    //!  value, one with no ':' which is not in braces. Throws ParseError for a list with an empty
+    //!  item, anything else with a ':' which is not a range, and a range which cannot reach its end
+    //!  or has too many values to count.
+    //!
+    bool parse(const string& name_in,const string& value)
+    {
+        if (value.size()>=2 && value[0]=='{' && value[value.size()-1]=='}') {
+            vector<string> list;
+            size_t from = 1;
+            for (;;) {
+                size_t comma = value.find(',',from);
+                if (comma==string::npos) comma = value.size()-1;
+                string item = trim(value.substr(from,comma-from));
+                if (item.empty() && !(list.empty() && comma==value.size()-1)) {
+                    throw ParseError(string("empty item in sweep list ")+value+" for "+name_in);
+                }
+                if (item.size()) list.push_back(item);
+                if (comma==value.size()-1) break;
+                from = comma+1;
+            }
+            if (list.empty()) throw ParseError(string("empty sweep list for ")+name_in);
+            name = name_in;
+            kind = LIST;
+            items.swap(list);
+            count = items.size();
+            return true;
+        }
+        size_t c1 = value.find(':');
+        if (c1==string::npos) return false;
+        string malformed = string("malformed sweep range ")+value+" for "+name_in+
+            ", expected start:stop:step or start:stop:logB";
+        size_t c2 = value.find(':',c1+1);
+        if (c2==string::npos || value.find(':',c2+1)!=string::npos) throw ParseError(malformed);
+        double a,b,s;
+        if (!toNumber(value.substr(0,c1),a) || !toNumber(value.substr(c1+1,c2-c1-1),b)) throw ParseError(malformed);
+        string spec = value.substr(c2+1);
+        if (spec.compare(0,3,"log")==0) {
+            if (!toNumber(spec.substr(3),s)) throw ParseError(malformed);
+            if (s<=1. || a==0. || a*b<=0.) throw ParseError(string("sweep ")+value+" cannot reach its end");
+            kind = LOG;
+            double n = log(b/a)/log(s);
+            if (n<0.) {
+                // a falling range, divide by B at each step
+                n = -n;
+                s = 1./s;
+            }
+            count = countOf(n,value);
+        }
+        else {
+            if (!toNumber(spec,s)) throw ParseError(malformed);
+            if (s==0. || (b-a)/s<-1.e-9) throw ParseError(string("sweep ")+value+" cannot reach its end");
+            kind = LINEAR;
+            count = countOf((b-a)/s,value);
+        }
+        name = name_in;
+        start = a;
+        step = s;
+        return true;
+    };
+
+    const string& optionName() const throw ()
+    {
+        return name;
+    };
+
+    size_t size() const throw ()
+    {
+        return count;
+    };
+
+    //!
+    //! \brief the k-th value as text, with at most 15 significant digits so that rounding noise in
+    //!  start+k*step does not show
+    //!
+    string value(size_t k) const
+    {
+        if (kind==LIST) return items[k];
+        double v = (kind==LINEAR) ? start+double(k)*step:start*pow(step,double(k));
+        char buf[32];
+        int n = snprintf(buf,sizeof(buf),"%.15g",v);
+        return string(buf,n);
+    };
+
+private:
+    enum kind_t { LIST, LINEAR, LOG };
+    string name;
+    kind_t kind;
+    vector<string> items;
+    double start;
+    double step;
+    size_t count;
+
+    static bool toNumber(const string& s,double& x)
+    {
+        if (s.empty()) return false;
+        char *end;
+        x = strtod(s.c_str(),&end);
+        return *end==0 && end!=s.c_str() && isfinite(x);
+    };
+
+    //!
+    //! \brief the number of values of a range spanning n steps, if it can be counted
+    //!
+    static size_t countOf(double n,const string& value)
+    {
+        // also refuses a ratio which is not a number
+        if (!(n>=0. && n<1.e15)) throw ParseError(string("sweep ")+value+" has too many points");
+        return size_t(n+1.e-9)+1;
+    };
+
+    static string trim(const string& s)
+    {
+        size_t b = s.find_first_not_of(" \t");
+        if (b==string::npos) return string();
+        size_t e = s.find_last_not_of(" \t");
+        return s.substr(b,e-b+1);
+    };
+};
+
+class ParameterSweep;
+
+//!
+//! \brief one configuration of a sweep: the swept options take this point's values and every other
+//!  option the value of the ProgramOptions the sweep was made from, which is shared, not copied
+//!
+class SweepPoint {
+public:
+    SweepPoint(const ParameterSweep& sweep_in,size_t index_in):sweep(&sweep_in),idx(index_in) {};
+
+    size_t index() const throw ()
+    {
+        return idx;
+    };
+
+    //!
+    //! \brief the value of option_name at this point
+    //!
+    string getValue(const string& option_name) const;
+
+    //!
+    //! \brief the position of this point along axis d of the sweep
+    //!
+    size_t coordinate(size_t d) const;
+
+    //!
+    //! \brief write the swept options of this point as name=value pairs separated by spaces
+    //!
+    string describe() const;
+
+private:
+    const ParameterSweep *sweep;
+    size_t idx;
+};
+
+//!
+//! \brief the Cartesian product of the lists and ranges given as option values.
+//!
+//!  Made from a ProgramOptions whose sources have been parsed and the names of the options to sweep,
+//!  each of those whose value is a list or a range (see SweepAxis) becomes an axis. Only the named
+//!  options are read as sweeps, so other values which look like one, e.g. 12:00:00 or {}, are left
+//!  alone. Nothing is expanded: point(i) works out the value on each axis from i with the last axis
+//!  varying fastest, so points can be taken in any order, e.g. for (i=rank; i<sweep.size();
+//!  i+=nranks) to share a sweep between processes. Iterating gives the points in order.
+//!
+class ParameterSweep {
+public:
+    //!
+    //! \brief sweep the options named in swept, in that order. Throws ParseError for a name which is
+    //!  not an option or a value which has a ':' or braces but is not a well formed list or range
+    //!  (see SweepAxis::parse); only a plain value is left unswept.
+    //!
+    ParameterSweep(const ProgramOptions& base_in,const vector<string>& swept):base(base_in),total(1)
+    {
+        for (size_t k=0; k<swept.size(); ++k) {
+            const string& name = swept[k];
+            if (!base.hasOption(name)) throw ParseError(string("sweep names no option named ")+name);
+            if (axis_index.count(name) || !base.hasValue(name)) continue;
+            SweepAxis axis;
+            if (!axis.parse(name,base.getValue(name))) continue;
+            if (total>size_t(-1)/axis.size()) throw ParseError(string("sweep has too many points"));
+            total *= axis.size();
+            axis_index.insert(make_pair(name,axes.size()));
+            axes.push_back(axis);
+        }
+        strides.resize(axes.size());
+        size_t stride = 1;
+        for (size_t d=axes.size(); d--;) {
+            strides[d] = stride;
+            stride *= axes[d].size();
+        }
+    };
+
+    virtual ~ParameterSweep()
+    {
+    };
+
+    //!
+    //! \brief the number of configurations, one when nothing is swept
+    //!
+    size_t size() const throw ()
+    {
+        return total;
+    };
+
+    size_t dimensions() const throw ()
+    {
+        return axes.size();
+    };
+
+    const SweepAxis& axis(size_t d) const throw ()
+    {
+        return axes[d];
+    };
+
+    SweepPoint point(size_t index) const
+    {
+        if (index>=total) throw ParseError(string("sweep index ")+type2string(index)+" out of range");
+        return SweepPoint(*this,index);
+    };
+
+    SweepPoint operator[](size_t index) const
+    {
+        return SweepPoint(*this,index);
+    };
+
+    class iterator {
+    public:
+        typedef forward_iterator_tag iterator_category;
+        typedef SweepPoint value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const SweepPoint *pointer;
+        typedef SweepPoint reference;
+
+        iterator(const ParameterSweep& sweep_in,size_t index_in):sweep(&sweep_in),idx(index_in) {};
+
+        SweepPoint operator*() const
+        {
+            return SweepPoint(*sweep,idx);
+        };
+
+        iterator& operator++()
+        {
+            ++idx;
+            return *this;
+        };
+
+        bool operator==(const iterator& it) const throw ()
+        {
+            return idx==it.idx;
+        };
+
+        bool operator!=(const iterator& it) const throw ()
+        {
+            return idx!=it.idx;
+        };
+
+    private:
+        const ParameterSweep *sweep;
+        size_t idx;
+    };
+
+    iterator begin() const
+    {
+        return iterator(*this,0);
+    };
+
+    iterator end() const
+    {
+        return iterator(*this,total);
+    };
+
+private:
+    friend class SweepPoint;
+    const ProgramOptions& base;
+    vector<SweepAxis> axes;
+    vector<size_t> strides;
+    unordered_map<string,size_t> axis_index;
+    size_t total;
+};
+
+inline size_t SweepPoint::coordinate(size_t d) const
+{
+    return (idx/sweep->strides[d])%sweep->axes[d].size();
+}
+
+inline string SweepPoint::getValue(const string& option_name) const
+{
+    unordered_map<string,size_t>::const_iterator iter = sweep->axis_index.find(option_name);
+    if (iter==sweep->axis_index.end()) return sweep->base.getValue(option_name);
+    return sweep->axes[iter->second].value(coordinate(iter->second));
+}
+
+inline string SweepPoint::describe() const
+{
+    string s;
+    for (size_t d=0; d<sweep->axes.size(); ++d) {
+        if (d) s += " ";
+        s += sweep->axes[d].optionName()+"="+sweep->axes[d].value(coordinate(d));
+    }
+    return s;
+}
+
+}
+#endif /* PARAMETERSWEEP_HPP_ */
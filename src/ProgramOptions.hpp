@@ -19,59 +19,215 @@
 #include <sstream>
 #include <fstream>
 #include <cstdlib>
-#include <fstream>
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <limits>
 #include "putils.hpp"
 #include "FilePathUtils.h"
+#include "BatchFileReader.hpp"
+#include "StructuredOptionReader.hpp"
+#include "OptionWriter.hpp"
+#include "StringPool.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include "ArgumentReader.hpp"
+#include "OptionTokenizer.hpp"
+#include "Tunables.hpp"
+#include "Fingerprint.hpp"
 using namespace std;
 
 namespace putils {
+//!
+//! \brief refers to one option of one ProgramOptions, as returned by addOption.
+//!
+//!  Passing a handle instead of a name makes an access a direct array access. The generation
+//!  identifies the ProgramOptions the handle came from and is checked, with the index, unless
+//!  NDEBUG is defined.
+//!
+struct OptionHandle {
+    unsigned int index;
+    unsigned int generation;
+
+    OptionHandle():index(~0U),generation(0) {};
+    OptionHandle(unsigned int index_in,unsigned int generation_in):index(index_in),generation(generation_in) {};
+
+    bool operator==(const OptionHandle& h) const throw ()
+    {
+        return index==h.index && generation==h.generation;
+    };
+};
+
+//!
+//! \brief the new value of one option, as passed to the subscribers of ProgramOptions.
+//!  has_value is false when the option no longer has a value.
+//!
+struct OptionChange {
+    string name;
+    string value;
+    bool has_value;
+};
+typedef vector<OptionChange> OptionChangeSet;
+typedef function<void(const OptionChangeSet&)> OptionChangeCallback;
+
 //!
 //! \brief a program options class.
 //!
 //!  excepts most major input format schemes e.g.  --name=value, --name value , -name value and -name=value.
 //!   one can also read in the name value pairs from a file or the environment.
 //!
+//!  Each source (the command line, each option file, the environment and values given to setValue)
+//!  is kept as a separate layer. The value of an option comes from the first source parsed which
+//!  gives it, otherwise from its default. Parsing a source again replaces its layer and re-resolves
+//!  only the options that layer names, and sourceOf tells which source supplied a value.
+//!
 class ProgramOptions {
 private:
     struct option_t {
     private:
-        string key;
-        string des;
+        InternedString key;
+        InternedString des;
         string val;
+        InternedString ival;
+        InternedString def;
+        bool has_def;
+        bool interned;
         int stat;
+        int src;
+        bool stale;
+        function<void(const string&)> setter;
+        string (*normalize)(const string&);
+        Fingerprint print;
     public:
         option_t(const string& option_name, const string& description,
                  const string& default_value) :
-            key(option_name), des(description), val(default_value), stat(-1)
+            key(StringPool::global().intern(option_name)), des(StringPool::global().intern(description)), val(), ival(),
+            def(StringPool::global().intern(default_value)), has_def(true), interned(true), stat(-1), src(-1), stale(false), setter(), normalize(0), print()
         {
+            ival = def;
         }
         ;
         option_t(const string& option_name, const string& description) :
-            key(option_name), des(description), val(""), stat(0)
+            key(StringPool::global().intern(option_name)), des(StringPool::global().intern(description)), val(), ival(), def(),
+            has_def(false), interned(true), stat(0), src(-1), stale(false), setter(), normalize(0), print()
+        {
+        }
+        ;
+
+        //!
+        //! \brief make value, taken from source layer number layer, the resolved value. A null value
+        //!  falls back to the default. Returns true when the resolved value changed.
+        //!
+        //!  A new value is given to the setter first, so when the setter throws the option keeps
+        //!  its previous value and state.
+        //!
+        bool resolve(const string* value,int layer,bool intern_value=false)
+        {
+            int new_stat = (value) ? 1:((has_def) ? -1:0);
+            bool changed = (new_stat!=stat);
+            if (!changed) {
+                if (value) changed = !valueEquals(*value);
+                else changed = !(interned && ival==def);
+            }
+            if (changed && setter && new_stat) setter((value) ? *value:def.str());
+            stat = new_stat;
+            src = (value) ? layer:-1;
+            stale = false;
+            if (changed) {
+                if (!value) {
+                    ival = def;
+                    interned = true;
+                    val.clear();
+                }
+                else if (intern_value) {
+                    ival = StringPool::global().intern(*value);
+                    interned = true;
+                    val.clear();
+                }
+                else {
+                    val = *value;
+                    interned = false;
+                }
+            }
+            return changed;
+        }
+        ;
+        bool valueEquals(const string& value) const throw ()
         {
+            if (!interned) return val==value;
+            return ival.size()==value.size() && memcmp(ival.data(),value.data(),value.size())==0;
         }
         ;
-        option_t(const char* option_name, const char * description,
-                 const char * default_value) :
-            key(option_name), des(description), val(default_value), stat(-1)
+        //!
+        //! \brief pass every new value of the option to setter, starting with the current one
+        //!
+        void bind(const function<void(const string&)>& f)
         {
+            setter = f;
+            if (setter && stat) setter(getValue());
         }
         ;
-        option_t(const char* option_name, const char * description) :
-            key(option_name), des(description), val(""), stat(0)
+        bool isBound() const throw ()
         {
+            return static_cast<bool>(setter);
         }
         ;
-
-        void setValue(const string& new_value)
+        //!
+        //! \brief write values in the canonical text f gives, e.g. for the type the option is bound
+        //!  to, when fingerprinting them
+        //!
+        void setNormalizer(string (*f)(const string&))
         {
-            if (stat != 1) {
-                stat = 1;
-                val = new_value;
-            }
+            normalize = f;
+        }
+        ;
+        //!
+        //! \brief the fingerprint of the name and the canonical value, zero when there is no value
+        //!
+        Fingerprint valuePrint() const
+        {
+            if (!stat) return Fingerprint();
+            string text = key.str();
+            text.push_back('\0');
+            text += (normalize) ? normalize(getValue()):getValue();
+            return Fingerprint::of(text.data(),text.size());
+        }
+        ;
+        //!
+        //! \brief replace the part of total due to this option by its current value
+        //!
+        void updatePrint(Fingerprint& total)
+        {
+            total -= print;
+            print = valuePrint();
+            total += print;
+        }
+        ;
+        //!
+        //! \brief mark the value as needing to be resolved again before it is next used
+        //!
+        void markStale() throw ()
+        {
+            stale = true;
+        }
+        ;
+        bool isStale() const throw ()
+        {
+            return stale;
+        }
+        ;
+        //!
+        //! \brief the index of the layer which supplied the value, -1 for the default or no value
+        //!
+        int source() const throw ()
+        {
+            return src;
         }
         ;
-
         bool hasValue() const throw ()
         {
             return (stat != 0);
@@ -84,22 +240,27 @@ private:
         ;
         bool matches(const string& option_name) const throw ()
         {
-            return key.compare(option_name) == 0;
+            return key.size()==option_name.size() && memcmp(key.data(),option_name.data(),key.size())==0;
         }
         ;
         bool matches(const char * option_name) const throw ()
         {
-            return key.compare(option_name) == 0;
+            return strcmp(key.c_str(),option_name) == 0;
         }
         ;
         string getOptionName() const throw ()
         {
-            return string(key);
+            return key.str();
+        }
+        ;
+        InternedString name() const throw ()
+        {
+            return key;
         }
         ;
         string getValue() const throw ()
         {
-            return string(val);
+            return (interned) ? ival.str():val;
         }
         ;
         ostream& write2Stream(ostream& os) const
@@ -107,10 +268,10 @@ private:
             os << "-" << key << " = " << des << endl;
             if (stat) {
                 if (stat == 1) {
-                    os << "    value = " << val << " set by user\n";
+                    os << "    value = " << getValue() << " set by user\n";
                 }
                 else {
-                    os << "    value = " << val << " default value\n";
+                    os << "    value = " << getValue() << " default value\n";
                 }
             }
             return os;
@@ -122,8 +283,105 @@ private:
         };
     };
 
+    //!
+    //! \brief an option file line whose value has not been converted yet
+    //!
+    struct lazy_value_t {
+        size_t k;
+        size_t line;
+        OptionToken token;
+        bool done;
+        string value;
+    };
+
+    //!
+    //! \brief the values given by one source (a file, the environment, the command line ...)
+    //!  held as (option index, value) pairs sorted by option index.
+    //!
+    //!  In lazy mode an option file layer instead holds the mapped file and, sorted by option index,
+    //!  where each value is, and the environment layer only its prefix. Values are converted when
+    //!  first needed and problems found while indexing are kept in errors for validateAll.
+    //!
+    struct layer_t {
+        string name;
+        vector< pair<size_t,string> > values;
+        shared_ptr<MappedFile> file;
+        vector<lazy_value_t> lazy;
+        bool lazy_env;
+        string env_prefix;
+        vector<signed char> env_state;
+        vector<string> env_values;
+        vector<string> errors;
+
+        layer_t(const string& layer_name):name(layer_name),values(),lazy_env(false) {};
+
+        const string *find(size_t k) const throw ()
+        {
+            size_t lo = 0;
+            size_t hi = values.size();
+            while (lo<hi) {
+                size_t mid = (lo+hi)/2;
+                if (values[mid].first<k) lo = mid+1;
+                else hi = mid;
+            }
+            if (lo<values.size() && values[lo].first==k) return &values[lo].second;
+            return 0;
+        };
+
+        bool isLazy() const throw ()
+        {
+            return lazy_env || file;
+        };
+    };
+    typedef vector< pair<size_t,string> > layer_values_t;
+
     vector<option_t> opts;
+    vector<layer_t> layers;
+    //!
+    //! \brief the bytes of a name, either of an interned option name or of the text being looked up
+    //!
+    struct name_view_t {
+        const char *p;
+        size_t n;
+        name_view_t(const char *p_in,size_t n_in):p(p_in),n(n_in) {};
+        bool operator==(const name_view_t& v) const throw ()
+        {
+            return n==v.n && memcmp(p,v.p,n)==0;
+        };
+    };
+    struct name_view_hash {
+        size_t operator()(const name_view_t& v) const throw ()
+        {
+            return StringPool::hashBytes(v.p,v.n);
+        };
+    };
+    // the keys point into the string pool, which keeps interned names for the life of the program
+    typedef unordered_map<name_view_t,size_t,name_view_hash> index_t;
+    index_t index;
+    vector<size_t> bound;
     bool allow_unused_options;
+    bool lazy_mode;
+    bool intern_values;
+    size_t parse_threads;
+    bool response_files;
+    unsigned int generation;
+
+    //!
+    //! \brief a subscriber to changes, its options and the changes not yet passed to it
+    //!
+    struct subscriber_t {
+        OptionChangeCallback callback;
+        bool by_prefix;
+        string prefix;
+        vector<size_t> keys;
+        shared_ptr<OptionChangeSet> pending;
+    };
+    vector<subscriber_t> subscribers;
+    vector< vector<size_t> > watchers;
+    vector<size_t> changed;
+    int batch_depth;
+    shared_ptr<ThreadPool> notifier;
+    Fingerprint config_print;
 public:
     typedef vector<option_t>::iterator iterator;
     typedef vector<option_t>::const_iterator const_iterator;
@@ -131,7 +389,8 @@ public:
     ///!
     ///! \brief default constructor
     ///!
-    ProgramOptions():opts()
+    ProgramOptions():opts(),layers(),index(),bound(),allow_unused_options(false),lazy_mode(false),intern_values(false),parse_threads(1),response_files(false),
+        generation(nextGeneration()),subscribers(),watchers(),changed(),batch_depth(0),notifier(),config_print()
     {
     }
     ;
@@ -146,13 +405,8 @@ public:
     //!
     bool hasOption(const string& option_name) const throw ()
     {
-        const_iterator iter = opts.begin();
-        const_iterator iend = opts.end();
-        for (; iter != iend; ++iter) {
-            if (iter->matches(option_name))
-                return true;
-        }
-        return false;
+        size_t k;
+        return findIndex(option_name.data(),option_name.size(),k);
     }
     ;
 
@@ -190,6 +444,32 @@ public:
     }
     ;
     //!
+    //! \brief return the names of the options in the order they were added
+    //!
+    vector<string> getOptionNames() const
+    {
+        vector<string> names;
+        names.reserve(opts.size());
+        for (size_t k=0; k<opts.size(); ++k) names.push_back(opts[k].getOptionName());
+        return names;
+    }
+    ;
+    //!
+    //! \brief a 128 bit fingerprint of the resolved options, e.g. to key a cache of results.
+    //!
+    //!  Every option with a value adds the fingerprint of its name and value, so the order the
+    //!  options were added or given in does not matter. Values of options bound to a variable are
+    //!  taken in the canonical form of its type. The fingerprint is kept up to date as values change
+    //!  and reading it costs nothing, except in lazy mode where values waiting on a source are
+    //!  resolved first.
+    //!
+    Fingerprint fingerprint() const
+    {
+        if (lazy_mode) refreshAll();
+        return config_print;
+    }
+    ;
+    //!
     //! \brief return the value associated with the option_name as a string
     //!
     string getValue(const string& option_name) const throw ()
@@ -208,268 +488,1457 @@ public:
     //!
     //! \brief set the value associated with the option name with the given value.
     //!
+    //!  Values set this way form their own source layer, named "user", created by the first call.
+    //!  As with every other source the first value given for a name is the one kept.
+    //!
     void setValue(const string& option_name, const string& value)
+    {
+        size_t k;
+        if (!lookupOption(option_name,k)) return;
+        setUserValue(k,value);
+    }
+    ;
+
+    //!
+    //! \brief the value of the option, as getValue(option_name)
+    //!
+    string getValue(const OptionHandle& handle) const throw ()
     {
         try {
-            iterator iter = findIterator(option_name);
-            return iter->setValue(value);
+            return resolvedOption(handle).getValue();
         }
         catch (exception& e) {
-            if (allow_unused_options) {
-                cerr << "option " << option_name << " not found\n";
-                return;
-            }
-            cerr << "ProgramOption::setValue exception " << e.what() << endl;
+            cerr << "ProgramOption::getValue exception " << e.what() << endl;
             printHelp();
         }
+        return string("");
     }
     ;
-
     //!
-    //! \brief parse the command line for valid options and set their values to those given.
+    //! \brief whether the option has a value, as hasValue(option_name)
     //!
-    void parseCommandLine(int argc,char **argv) throw()
+    bool hasValue(const OptionHandle& handle) const throw ()
     {
         try {
-            for (int karg=1; karg<argc; ++karg) {
-                string targ ( argv[karg] );
-                if (targ.size()>2 && targ[0]=='-') {
-                    int s=1;
-                    if (targ[1]=='-') s=2;
-                    string check_help = targ.substr(s,string::npos);
-                    if (check_help.compare(0,4,"help")==0) {  
-                        printHelp();
-                    }
-                    size_t eq_pos = targ.find("=");
-                    if (eq_pos==string::npos) {
-                        // no equal in options value
-                        string key=targ.substr(s,string::npos);
-                        if (key.compare("help")==0) printHelp();
-                        int knext=karg+1;
-                        if (knext<argc && argv[knext][0]!='-') {
-                            string val(argv[knext]);
-                            setValue(key,val);
-                            ++karg;
-                        }
-                        else {
-                            string val("1");
-                            setValue(key,val);
-                        }
-                    }
-                    else {
-                        string key=targ.substr(s,(eq_pos-s));
-                        string val=targ.substr(eq_pos+1,string::npos);
-                        if (val.size())  {
-                            setValue(key,val);
-                        }
-                        else {
-                            setValue(key,string("1"));
-                        }
-                    }
-                }
-                else {
-                    cerr << "ProgramOptions error found " << targ << endl;
-                    string err("expected an -option_name but found value");
-                    throw ParseError(err);
-                }
-            }
+            return resolvedOption(handle).hasValue();
         }
         catch (exception& e) {
-            cerr << "ProgramOption::parseCommandLine exception " << e.what() << endl;
+            cerr << "ProgramOption::hasValue exception " << e.what() << endl;
             printHelp();
         }
-    };
-
+        return false;
+    }
+    ;
     //!
-    //! \brief parse a file for valid options and set their values to those given.
+    //! \brief whether the option was set by the user, as wasSet(option_name)
     //!
-    void parseOptionFile(const string& options_filename) throw()
+    bool wasSet(const OptionHandle& handle) const throw ()
     {
-        if (!isRegularFile(options_filename)) {
-            cerr << "File with options :" << options_filename << " do not exist or is not a regular file!\n";
-            exit(EXIT_FAILURE);
-        }
-        if (!canRead(options_filename)) {
-            cerr << "File with options :" << options_filename << " cannot be read!\n";
-            exit(EXIT_FAILURE);        
-        }
         try {
-            ifstream in;
-            in.exceptions(ifstream::badbit);
-            const string delims(" =\t\n\r\f");
-            in.open(options_filename.c_str());
-            string sline;
-            while (getline(in,sline)) {
-                if (sline.size()==0) break;
-                if (sline[0]=='!' || sline[0]=='#' || sline[0]=='[') continue;
-                cerr << "line :"<< sline << endl;
-                StringTokenizer tokenizer(sline,delims);
-                vector<string> tokens;
-                tokenizer.splitString(tokens);
-                tokenizer.rewind();
-                if (tokenizer.hasTokens()) {
-                    string key=tokenizer.nextToken();
-                    if (key.size()==0) {
-                        throw ParseError(string("zero size key"));
-                    }
-                    if (tokenizer.hasTokens()) {
-                        string val=tokenizer.nextToken();
-                        setValue(key,val);
-                    }
-                    else {
-                        setValue(key,string("true"));
-                    }
-                }
-                else {
-                    string err("no tokens found in option input file\n");
-                    throw ParseError(err);
-                }
-                if (in.eof() || !in) break;
-            }
-            in.close();
+            return resolvedOption(handle).wasSet();
         }
         catch (exception& e) {
-            cerr << "ProgramOption::parseOptionFile exception " << e.what() << endl;
+            cerr << "ProgramOption::wasSet exception " << e.what() << endl;
             printHelp();
         }
-        cerr << "parsed option file " << options_filename << endl;
-    };
+        return false;
+    }
+    ;
     //!
-    //! \brief parse the environment for valid options and set their values to those given.
-    //! note the options name must appear as all caps in the environment variable and may
-    //! be prefixed by the given string in all caps.
-    //! For example an option such as data would be DATA and if the prefix is MIN then
-    //! MIN_DATA.
+    //! \brief set the value of the option, as setValue(option_name,value)
+    //!
+    void setValue(const OptionHandle& handle, const string& value)
+    {
+        checkHandle(handle);
+        setUserValue(handle.index,value);
+    }
+    ;
     //!
+    //! \brief the handle of option_name, for options added before handles were kept
     //!
+    OptionHandle getHandle(const string& option_name) const throw ()
+    {
+        size_t k;
+        if (findIndex(option_name.data(),option_name.size(),k)) return OptionHandle(k,generation);
+        cerr << "ProgramOption::getHandle exception ProgramOptions could not find the option " << option_name << endl;
+        printHelp();
+        return OptionHandle();
+    }
+    ;
 
-    void parseEnvironment(const string& prefix=string("")) throw()
+
+    //!
+    //! \brief return the name of the source which supplied the value of option_name.
+    //!
+    //!  This is "command line", "environment", the file name for option files, "user" for values
+    //!  given to setValue, "default" for default values and empty when the option has no value.
+    //!
+    string sourceOf(const string& option_name) const throw ()
     {
         try {
-            if (prefix.size()) {
-                size_t sz=opts.size();
-                for (size_t k=0; k<sz; ++k) {
-                    string key = opts[k].getOptionName();
-                    for (size_t j=0; j<key.size(); ++j) {
-                        char ch = key[j];
-                        if (isalpha(ch)) {
-                            key[j] = toupper(ch);
-                        }
-                    }
-                    string env_name = prefix + "_" + key;
-                    char * ret=std::getenv(env_name.c_str());
-                    if (ret) {
-                        opts[k].setValue(string(ret));
-                    }
-                }
-            }
-            else {
-                size_t sz=opts.size();
-                for (size_t k=0; k<sz; ++k) {
-                    string key = opts[k].getOptionName();
-                    for (size_t j=0; j<key.size(); ++j) {
-                        char ch = key[j];
-                        if (isalpha(ch)) {
-                            key[j] = toupper(ch);
-                        }
-                    }
-                    char * ret=std::getenv(key.c_str());
-                    if (ret) {
-                        opts[k].setValue(string(ret));
-                    }
-                }
-            }
+            const_iterator iter = findConstIterator(option_name);
+            if (iter->source()>=0) return layers[iter->source()].name;
+            return (iter->hasValue()) ? string("default"):string("");
         }
         catch (exception& e) {
-            cerr << "ProgramOption::parseEnvironment exception " << e.what() << endl;
+            cerr << "ProgramOption::sourceOf exception " << e.what() << endl;
             printHelp();
         }
-    };
+        return string("");
+    }
+    ;
 
     //!
-    //! \brief add the option to the list with the given default value
+    //! \brief forget every value given by the named source, e.g. an option file about to be reparsed.
+    //!  The source keeps its place in the order of precedence.
     //!
-    void addOption(const string& option_name, const string& description,
-                   const string& default_value)
+    void clearSource(const string& source_name)
     {
-        opts.push_back(option_t(option_name,description,default_value));
+        for (size_t li=0; li<layers.size(); ++li) {
+            if (layers[li].name==source_name) {
+                layer_values_t empty;
+                replaceLayer(li,empty);
+                return;
+            }
+        }
     }
     ;
+
     //!
-    //! \brief add the option to the list
+    //! \brief add an empty source named source_name, if there is none, to fix its place in the order
+    //!  of precedence before values are given to it with setSourceValue
     //!
-    void addOption(const string& option_name, const string& description)
+    void addSource(const string& source_name)
     {
-        opts.push_back(option_t(option_name,description));
+        findLayer(source_name);
     }
     ;
+
     //!
-    //! \brief add the option to the list  with the given default value
+    //! \brief give option_name the value value in the named source, replacing any value the source
+    //!  gave it, and re-resolve the option. A source not seen before is added below the others.
     //!
-    void addOption(const char *  option_name, const char *  description,
-                   const char *  default_value)
+    void setSourceValue(const string& source_name, const string& option_name, const string& value)
     {
-        opts.push_back(option_t(option_name,description,default_value));
+        size_t k;
+        if (!lookupOption(option_name,k)) return;
+        layer_t& layer = layers[findLayer(source_name)];
+        if (layer.isLazy()) {
+            string err("cannot set a value in the lazily indexed source ");
+            err += source_name;
+            throw ParseError(err);
+        }
+        layer_values_t& vals = layer.values;
+        layer_values_t::iterator pos = lower_bound(vals.begin(),vals.end(),make_pair(k,string()),lessIndex);
+        bool replaced = (pos!=vals.end() && pos->first==k);
+        string previous;
+        if (replaced) {
+            previous.swap(pos->second);
+            pos->second = value;
+        }
+        else pos = vals.insert(pos,make_pair(k,value));
+        try {
+            resolveOption(k);
+        }
+        catch (...) {
+            // the option kept its value, put the source back as it was
+            if (replaced) pos->second.swap(previous);
+            else vals.erase(pos);
+            throw;
+        }
+        notifyChanges();
     }
     ;
+
     //!
-    //! \brief add the option to the list
+    //! \brief set value to the value the named source gives option_name and return true, or return
+    //!  false if it gives none. Lazily indexed sources give none.
     //!
-    void addOption(const char *  option_name, const char *  description)
+    bool getSourceValue(const string& source_name, const string& option_name, string& value) const
     {
-        opts.push_back(option_t(option_name,description));
+        size_t k;
+        if (!findIndex(option_name.data(),option_name.size(),k)) return false;
+        for (size_t li=0; li<layers.size(); ++li) {
+            if (layers[li].name!=source_name) continue;
+            const string *v = layers[li].find(k);
+            if (!v) return false;
+            value = *v;
+            return true;
+        }
+        return false;
     }
     ;
 
     //!
-    //! \brief helper method to write out options to a stream
+    //! \brief forget the value the named source gives option_name, if any, and re-resolve it
     //!
-    ostream& write2stream(ostream& os) const
+    void unsetSourceValue(const string& source_name, const string& option_name)
     {
-        const_iterator iter=opts.begin();
-        const_iterator iend=opts.end();
-        for (; iter!=iend; ++iter) {
-            iter->write2Stream(os);
+        size_t k;
+        if (!findIndex(option_name.data(),option_name.size(),k)) return;
+        for (size_t li=0; li<layers.size(); ++li) {
+            if (layers[li].name!=source_name || layers[li].isLazy()) continue;
+            layer_values_t& vals = layers[li].values;
+            layer_values_t::iterator pos = lower_bound(vals.begin(),vals.end(),make_pair(k,string()),lessIndex);
+            if (pos==vals.end() || pos->first!=k) return;
+            vals.erase(pos);
+            resolveOption(k);
+            notifyChanges();
+            return;
         }
-        return os;
     }
+    ;
 
     //!
-    //! \brief print out the options (name,descriptions and values) then exit.
+    //! \brief keep option values in the shared StringPool rather than in a string per option.
     //!
-    void printHelp() const
-    {
-        std::cerr << "Usage is:\n";
-        const_iterator iter=opts.begin();
-        const_iterator iend=opts.end();
-        for (; iter!=iend; ++iter) {
-            iter->write2Stream(cerr);
-        }
-        exit(EXIT_FAILURE);
-    };
-
-protected:
-    iterator findIterator(const string& option_name)
+    //!  Names and default values are always interned. Interning values as well saves memory when
+    //!  many options share a few values such as true, 1 or 0, but every distinct value then stays
+    //!  in the pool for the life of the program, so it is off by default.
+    //!
+    void internValues(bool flag)
     {
-        iterator iter = opts.begin();
-        const_iterator iend = opts.end();
-        for (; iter != iend; ++iter) {
-            if (iter->matches(option_name))
-                return iter;
-        }
-        string err("ProgramOptions could not find the option ");
-        err += option_name;
-        err += "\n";
-        throw runtime_error(err);
+        intern_values = flag;
     }
     ;
-    const_iterator findConstIterator(const string& option_name) const
+
+    //!
+    //! \brief the number of threads parseOptionFile uses for files of PARALLEL_PARSE_SIZE bytes or
+    //!  more. One, the default, parses serially and zero means one per hardware thread.
+    //!
+    //!  The file is mapped, split into chunks at line boundaries and each chunk tokenized on its own
+    //!  thread. The chunks are then joined in file order, so the values set and the errors reported
+    //!  are exactly those of a serial parse.
+    //!
+    void setParseThreads(size_t nthreads)
+    {
+        parse_threads = nthreads;
+    }
+    ;
+    enum { PARALLEL_PARSE_SIZE = 4*1024*1024 };
+
+    //!
+    //! \brief in lazy mode parseOptionFile and parseEnvironment only index their source.
+    //!
+    //!  An option file is mapped and the position of each value recorded; the value is converted the
+    //!  first time the option is used. The environment is only searched for an option when it is
+    //!  used. Unknown names and malformed lines are not reported while indexing, call validateAll to
+    //!  report them. Bound options are resolved while indexing, so a value one cannot take is
+    //!  reported by the parse. Note the const accessors then update the cached values, so a
+    //!  ProgramOptions shared between threads must be validated first; a value which cannot be
+    //!  converted when an accessor resolves it is reported and the help printed.
+    //!
+    void setLazy(bool flag)
+    {
+        lazy_mode = flag;
+    }
+    ;
+
+    //!
+    //! \brief convert every value not yet converted and report, in source and line order, the
+    //!  problems found in lazily indexed sources. Prints the help if there are any.
+    //!
+    void validateAll()
+    {
+        bool failed = false;
+        for (size_t li=0; li<layers.size(); ++li) {
+            for (size_t j=0; j<layers[li].errors.size(); ++j) {
+                cerr << "ProgramOption::validateAll " << layers[li].errors[j] << endl;
+                failed = true;
+            }
+        }
+        if (failed) printHelp();
+        for (size_t k=0; k<opts.size(); ++k) {
+            if (opts[k].isStale()) resolveOption(k);
+        }
+        notifyChanges();
+    }
+    ;
+
+    //!
+    //! \brief expand @file arguments given to parseCommandLine, see ArgumentReader. Off by default,
+    //!  so that an argument starting with @ is taken as it is unless the program asks otherwise.
+    //!
+    void setResponseFiles(bool flag)
+    {
+        response_files = flag;
+    }
+    ;
+    bool responseFiles() const throw ()
+    {
+        return response_files;
+    }
+    ;
+
+    //!
+    //! \brief parse the command line for valid options and set their values to those given.
+    //!  With setResponseFiles(true) an argument @file is replaced by the arguments in the file.
+    //!
+    void parseCommandLine(int argc,char **argv) throw()
+    {
+        TraceScope trace("ProgramOptions::parseCommandLine");
+        try {
+            layer_values_t vals;
+            ArgumentReader args(argc,argv,1,response_files);
+            const char *targ;
+            size_t tlen;
+            while (args.next(targ,tlen)) {
+                if (tlen>2 && targ[0]=='-') {
+                    size_t s=1;
+                    if (targ[1]=='-') s=2;
+                    if (tlen-s>=4 && memcmp(targ+s,"help",4)==0) {
+                        printHelp();
+                    }
+                    const char *eq = static_cast<const char*>(memchr(targ,'=',tlen));
+                    if (!eq) {
+                        // no equal in options value
+                        string key(targ+s,tlen-s);
+                        const char *next;
+                        size_t nlen;
+                        if (args.peek(next,nlen) && (nlen==0 || next[0]!='-')) {
+                            addValue(vals,key,string(next,nlen));
+                            args.next(next,nlen);
+                        }
+                        else {
+                            string val("1");
+                            addValue(vals,key,val);
+                        }
+                    }
+                    else {
+                        size_t eq_pos = eq-targ;
+                        string key(targ+s,(eq_pos<s) ? 0:eq_pos-s);
+                        if (eq_pos+1<tlen)  {
+                            addValue(vals,key,string(eq+1,targ+tlen));
+                        }
+                        else {
+                            addValue(vals,key,string("1"));
+                        }
+                    }
+                }
+                else {
+                    cerr << "ProgramOptions error found " << string(targ,tlen) << endl;
+                    string err("expected an -option_name but found value");
+                    throw ParseError(err);
+                }
+            }
+            replaceLayer(findLayer("command line"),vals);
+        }
+        catch (exception& e) {
+            cerr << "ProgramOption::parseCommandLine exception " << e.what() << endl;
+            printHelp();
+        }
+    };
+
+    //!
+    //! \brief parse a file for valid options and set their values to those given.
+    //!  Parsing the same file again replaces the values it gave before. See OptionTokenizer for
+    //!  the syntax; malformed lines are reported with their line number.
+    //!
+    void parseOptionFile(const string& options_filename) throw()
+    {
+        TraceScope trace("ProgramOptions::parseOptionFile");
+        FileInfo info(options_filename);
+        if (!info.isRegularFile()) {
+            cerr << "File with options :" << options_filename << " do not exist or is not a regular file!\n";
+            exit(EXIT_FAILURE);
+        }
+        if (!info.canRead()) {
+            cerr << "File with options :" << options_filename << " cannot be read!\n";
+            exit(EXIT_FAILURE);        
+        }
+        if (lazy_mode) {
+            try {
+                indexOptionFile(options_filename);
+                refreshBound();
+            }
+            catch (exception& e) {
+                cerr << "ProgramOption::parseOptionFile exception " << e.what() << endl;
+                printHelp();
+            }
+            return;
+        }
+        if (parse_threads!=1 && info.size()>=size_t(PARALLEL_PARSE_SIZE)) {
+            try {
+                layer_values_t vals;
+                splitOptionFileParallel(options_filename,vals);
+                replaceLayer(findLayer(options_filename),vals);
+            }
+            catch (exception& e) {
+                cerr << "ProgramOption::parseOptionFile exception " << e.what() << endl;
+                printHelp();
+            }
+            cerr << "parsed option file " << options_filename << endl;
+            return;
+        }
+        try {
+            loadOptionFile(options_filename);
+        }
+        catch (exception& e) {
+            cerr << "ProgramOption::parseOptionFile exception " << e.what() << endl;
+            printHelp();
+        }
+        cerr << "parsed option file " << options_filename << endl;
+    };
+    //!
+    //! \brief as parseOptionFile, for a program which must keep running: errors throw instead of
+    //!  printing the help and exiting, and leave the options as they were. Throws SystemError if the
+    //!  file cannot be read, ParseError for a malformed line, an unknown option (unless unused
+    //!  options are allowed) or a value a bound option cannot take.
+    //!
+    void loadOptionFile(const string& options_filename)
+    {
+        string text;
+        int e = BatchFileReader::readFile(options_filename,text);
+        if (e) throw SystemError(string("reading ")+options_filename,e);
+        vector< pair<string,string> > pairs;
+        splitOptionText(text.data(),text.size(),pairs);
+        layer_values_t vals;
+        for (size_t j=0; j<pairs.size(); ++j) {
+            size_t k;
+            if (findIndex(pairs[j].first.data(),pairs[j].first.size(),k)) {
+                vals.push_back(make_pair(k,string()));
+                vals.back().second.swap(pairs[j].second);
+            }
+            else if (allow_unused_options) {
+                cerr << "option " << pairs[j].first << " not found\n";
+            }
+            else {
+                throw ParseError(options_filename+": ProgramOptions could not find the option "+pairs[j].first);
+            }
+        }
+        replaceLayer(findLayer(options_filename),vals);
+    };
+    //!
+    //! \brief parse a JSON file, naming the members of nested objects with dotted names (see JsonOptionReader)
+    //!
+    void parseJsonFile(const string& json_filename) throw()
+    {
+        TraceScope trace("ProgramOptions::parseJsonFile");
+        try {
+            MappedFile file(json_filename);
+            layer_values_t vals;
+            JsonOptionReader reader;
+            reader.parse(file.data(),file.size(),[&](const string& key,const string& value) {
+                addValue(vals,key,value);
+            });
+            replaceLayer(findLayer(json_filename),vals);
+        }
+        catch (exception& e) {
+            cerr << "ProgramOption::parseJsonFile " << json_filename << " exception " << e.what() << endl;
+            printHelp();
+        }
+    };
+    //!
+    //! \brief parse a TOML file, naming the keys of tables with dotted names (see TomlOptionReader)
+    //!
+    void parseTomlFile(const string& toml_filename) throw()
+    {
+        TraceScope trace("ProgramOptions::parseTomlFile");
+        try {
+            MappedFile file(toml_filename);
+            layer_values_t vals;
+            TomlOptionReader reader;
+            reader.parse(file.data(),file.size(),[&](const string& key,const string& value) {
+                addValue(vals,key,value);
+            });
+            replaceLayer(findLayer(toml_filename),vals);
+        }
+        catch (exception& e) {
+            cerr << "ProgramOption::parseTomlFile " << toml_filename << " exception " << e.what() << endl;
+            printHelp();
+        }
+    };
+    //!
+    //! \brief when true names not registered with addOption are reported and skipped instead of
+    //!  printing the help, e.g. for shared configuration files which also serve other programs.
+    //!
+    void allowUnusedOptions(bool flag)
+    {
+        allow_unused_options = flag;
+    };
+    //!
+    //! \brief parse several option files, as parseOptionFile would one after another.
+    //!
+    //!  All of the files are read at once (see BatchFileReader) and each is split into name value
+    //!  pairs as soon as it arrives. The values are then set in the order the files are given, so an
+    //!  earlier file wins over a later one exactly as with repeated parseOptionFile calls.
+    //!
+    void parseOptionFiles(const vector<string>& options_filenames) throw()
+    {
+        TraceScope trace("ProgramOptions::parseOptionFiles");
+        size_t nfiles = options_filenames.size();
+        // subscribers see the files as one set of changes
+        beginChanges();
+        if (lazy_mode) {
+            // indexing only maps the files, there is nothing to overlap
+            for (size_t k=0; k<nfiles; ++k) parseOptionFile(options_filenames[k]);
+            endChanges();
+            return;
+        }
+        vector< vector< pair<string,string> > > pairs(nfiles);
+        vector<string> errors(nfiles);
+        try {
+            BatchFileReader reader;
+            reader.readAll(options_filenames,[&](size_t k,int e,const char *data,size_t len) {
+                if (e) {
+                    errors[k] = (e==EINVAL) ? string(" do not exist or is not a regular file!"):
+                                string(" cannot be read! ")+strerror(e);
+                    return;
+                }
+                try {
+                    splitOptionText(data,len,pairs[k]);
+                }
+                catch (exception& ex) {
+                    errors[k] = string(" parse error ")+ex.what();
+                }
+            });
+        }
+        catch (exception& e) {
+            cerr << "ProgramOption::parseOptionFiles exception " << e.what() << endl;
+            printHelp();
+        }
+        for (size_t k=0; k<nfiles; ++k) {
+            if (errors[k].size()) {
+                cerr << "File with options :" << options_filenames[k] << errors[k] << "\n";
+                exit(EXIT_FAILURE);
+            }
+            layer_values_t vals;
+            for (size_t j=0; j<pairs[k].size(); ++j) addValue(vals,pairs[k][j].first,pairs[k][j].second);
+            replaceLayer(findLayer(options_filenames[k]),vals);
+            cerr << "parsed option file " << options_filenames[k] << endl;
+        }
+        endChanges();
+    };
+    //!
+    //! \brief parse the environment for valid options and set their values to those given.
+    //! note the options name must appear as all caps in the environment variable and may
+    //! be prefixed by the given string in all caps.
+    //! For example an option such as data would be DATA and if the prefix is MIN then
+    //! MIN_DATA.
+    //!
+    //!
+
+    void parseEnvironment(const string& prefix=string("")) throw()
+    {
+        TraceScope trace("ProgramOptions::parseEnvironment");
+        if (lazy_mode) {
+            size_t li = findLayer((prefix.size()) ? "environment "+prefix:string("environment"));
+            layer_t& layer = layers[li];
+            dropLazy(layer);
+            layer.values.clear();
+            layer.lazy_env = true;
+            layer.env_prefix = prefix;
+            layer.env_state.assign(opts.size(),0);
+            layer.env_values.assign(opts.size(),string());
+            for (size_t k=0; k<opts.size(); ++k) opts[k].markStale();
+            try {
+                refreshBound();
+            }
+            catch (exception& e) {
+                cerr << "ProgramOption::parseEnvironment exception " << e.what() << endl;
+                printHelp();
+            }
+            return;
+        }
+        try {
+            layer_values_t vals;
+            if (prefix.size()) {
+                size_t sz=opts.size();
+                for (size_t k=0; k<sz; ++k) {
+                    string key = opts[k].getOptionName();
+                    for (size_t j=0; j<key.size(); ++j) {
+                        char ch = key[j];
+                        if (isalpha(ch)) {
+                            key[j] = toupper(ch);
+                        }
+                    }
+                    string env_name = prefix + "_" + key;
+                    char * ret=std::getenv(env_name.c_str());
+                    if (ret) {
+                        vals.push_back(make_pair(k,string(ret)));
+                    }
+                }
+            }
+            else {
+                size_t sz=opts.size();
+                for (size_t k=0; k<sz; ++k) {
+                    string key = opts[k].getOptionName();
+                    for (size_t j=0; j<key.size(); ++j) {
+                        char ch = key[j];
+                        if (isalpha(ch)) {
+                            key[j] = toupper(ch);
+                        }
+                    }
+                    char * ret=std::getenv(key.c_str());
+                    if (ret) {
+                        vals.push_back(make_pair(k,string(ret)));
+                    }
+                }
+            }
+            replaceLayer(findLayer((prefix.size()) ? "environment "+prefix:string("environment")),vals);
+        }
+        catch (exception& e) {
+            cerr << "ProgramOption::parseEnvironment exception " << e.what() << endl;
+            printHelp();
+        }
+    };
+
+    //!
+    //! \brief add the option to the list with the given default value
+    //!
+    OptionHandle addOption(const string& option_name, const string& description,
+                   const string& default_value)
+    {
+        return appendOption(option_t(option_name,description,default_value));
+    }
+    ;
+    //!
+    //! \brief add the option to the list
+    //!
+    OptionHandle addOption(const string& option_name, const string& description)
+    {
+        return appendOption(option_t(option_name,description));
+    }
+    ;
+    //!
+    //! \brief add the option to the list  with the given default value
+    //!
+    OptionHandle addOption(const char *  option_name, const char *  description,
+                   const char *  default_value)
+    {
+        return appendOption(option_t(option_name,description,default_value));
+    }
+    ;
+    //!
+    //! \brief add the option to the list
+    //!
+    OptionHandle addOption(const char *  option_name, const char *  description)
+    {
+        return appendOption(option_t(option_name,description));
+    }
+    ;
+
+    //!
+    //! \brief add the option with the given default value and bind it to target.
+    //!
+    //!  Whenever the value of the option changes, from any source, it is converted once with
+    //!  string2type<T> and stored in target, which is given the default value straight away. Reading
+    //!  target then needs no lookup or conversion. In lazy mode bound options are resolved as soon as
+    //!  a source is indexed so target is always up to date.
+    //!
+    template<typename T>
+    typename enable_if<!is_convertible<T&,function<void(const string&)> >::value,OptionHandle>::type
+    addOption(const string& option_name, const string& description,
+              const string& default_value, T& target)
+    {
+        OptionHandle handle = addOption(option_name,description,default_value);
+        T *ptr = &target;
+        bindOption(handle.index,[ptr](const string& value) {
+            *ptr = string2type<T>(value);
+        },&normalizedValue<T>);
+        return handle;
+    }
+    ;
+    //!
+    //! \brief add the option and bind it to target, which is left alone until a value is given.
+    //!  Strings can only be bound with the overload taking a default value, as a string here would be
+    //!  taken as the default value.
+    //!
+    template<typename T>
+    typename enable_if<!is_convertible<T&,string>::value &&
+                       !is_convertible<T&,function<void(const string&)> >::value,OptionHandle>::type
+    addOption(const string& option_name, const string& description, T& target)
+    {
+        OptionHandle handle = addOption(option_name,description);
+        T *ptr = &target;
+        bindOption(handle.index,[ptr](const string& value) {
+            *ptr = string2type<T>(value);
+        },&normalizedValue<T>);
+        return handle;
+    }
+    ;
+    //!
+    //! \brief add the option with the given default value and bind it to the tunable target, which
+    //!  is given each new value with a single store and can be read from any thread (see Tunable)
+    //!
+    template<typename T>
+    OptionHandle addOption(const string& option_name, const string& description,
+                           const string& default_value, Tunable<T>& target)
+    {
+        OptionHandle handle = addOption(option_name,description,default_value);
+        Tunable<T> *ptr = &target;
+        bindOption(handle.index,[ptr](const string& value) {
+            ptr->store(string2type<T>(value));
+        },&normalizedValue<T>);
+        return handle;
+    }
+    ;
+    //!
+    //! \brief add the option with the given default value and pass every new value to setter,
+    //!  starting with the default
+    //!
+    OptionHandle addOption(const string& option_name, const string& description,
+                           const string& default_value, const function<void(const string&)>& setter)
+    {
+        OptionHandle handle = addOption(option_name,description,default_value);
+        bindOption(handle.index,setter);
+        return handle;
+    }
+    ;
+    //!
+    //! \brief add the option and pass every value it is given to setter
+    //!
+    OptionHandle addOption(const string& option_name, const string& description,
+                           const function<void(const string&)>& setter)
+    {
+        OptionHandle handle = addOption(option_name,description);
+        bindOption(handle.index,setter);
+        return handle;
+    }
+    ;
+
+    //!
+    //! \brief call f with the changes to option_name. Returns the subscription, for unsubscribe.
+    //!
+    //!  The changes made by one parse, setValue or batch (see beginChanges) are passed to each
+    //!  subscriber as one set, holding each changed option once with its final value. Subscribers are
+    //!  called in order on a thread of their own, never on the thread making the changes, with copies
+    //!  of the values, and must not use the ProgramOptions. The work per change is proportional to
+    //!  the options which changed and their subscribers, whatever the number of other options.
+    //!
+    size_t subscribe(const string& option_name,const OptionChangeCallback& f)
+    {
+        return subscribe(vector<string>(1,option_name),f);
+    }
+    ;
+    //!
+    //! \brief call f with the changes to any of option_names, as one set per batch
+    //!
+    size_t subscribe(const vector<string>& option_names,const OptionChangeCallback& f)
+    {
+        subscriber_t sub;
+        sub.callback = f;
+        sub.by_prefix = false;
+        for (size_t j=0; j<option_names.size(); ++j) {
+            size_t k;
+            if (lookupOption(option_names[j],k)) sub.keys.push_back(k);
+        }
+        return addSubscriber(sub);
+    }
+    ;
+    //!
+    //! \brief call f with the changes to every option whose name starts with prefix, including
+    //!  options added later
+    //!
+    size_t subscribePrefix(const string& prefix,const OptionChangeCallback& f)
+    {
+        subscriber_t sub;
+        sub.callback = f;
+        sub.by_prefix = true;
+        sub.prefix = prefix;
+        for (size_t k=0; k<opts.size(); ++k) {
+            if (opts[k].name().str().compare(0,prefix.size(),prefix)==0) sub.keys.push_back(k);
+        }
+        return addSubscriber(sub);
+    }
+    ;
+    //!
+    //! \brief stop passing changes to a subscriber. Sets already queued are still delivered.
+    //!
+    void unsubscribe(size_t id)
+    {
+        if (id>=subscribers.size() || !subscribers[id].callback) return;
+        subscriber_t& sub = subscribers[id];
+        for (size_t j=0; j<sub.keys.size(); ++j) {
+            vector<size_t>& w = watchers[sub.keys[j]];
+            w.erase(remove(w.begin(),w.end(),id),w.end());
+        }
+        sub.callback = OptionChangeCallback();
+        sub.keys.clear();
+        sub.pending.reset();
+    }
+    ;
+    //!
+    //! \brief hold back change notifications until the matching endChanges, so that the changes made
+    //!  in between, e.g. by several setValue calls, reach each subscriber as one set. Calls nest.
+    //!
+    void beginChanges()
+    {
+        ++batch_depth;
+    }
+    ;
+    void endChanges()
+    {
+        if (batch_depth>0) --batch_depth;
+        notifyChanges();
+    }
+    ;
+    //!
+    //! \brief wait until every subscriber has been given the changes made so far. Rethrows the
+    //!  first exception a subscriber threw.
+    //!
+    void waitForNotifications()
+    {
+        if (notifier) notifier->wait();
+    }
+    ;
+
+    //!
+    //! \brief helper method to write out options to a stream
+    //!
+    ostream& write2stream(ostream& os) const
+    {
+        refreshAll();
+        const_iterator iter=opts.begin();
+        const_iterator iend=opts.end();
+        for (; iter!=iend; ++iter) {
+            iter->write2Stream(os);
+        }
+        return os;
+    }
+
+    //!
+    //! \brief the formats exportOptions writes
+    //!
+    //!  EXPORT_JSON writes one object of name value members which parseJsonFile reads back,
+    //!  EXPORT_ENVIRONMENT writes export lines for parseEnvironment with the same prefix and
+    //!  EXPORT_OPTION_FILE writes name value lines for parseOptionFile.
+    //!
+    enum export_format_t { EXPORT_JSON, EXPORT_ENVIRONMENT, EXPORT_OPTION_FILE };
+
+    //!
+    //! \brief append every option which has a value, as resolved now, to out in the given format.
+    //!
+    //!  Values are written exactly, quoted and escaped only where the format needs it. Names which
+    //!  the format cannot carry (e.g. a name which is not a valid shell variable) are written as
+    //!  comments, except in JSON where every name can be written.
+    //!
+    void exportOptions(OutputBuffer& out,export_format_t format,const string& prefix=string("")) const
+    {
+        refreshAll();
+        if (format==EXPORT_JSON) out.append('{');
+        bool first = true;
+        for (size_t k=0; k<opts.size(); ++k) {
+            const option_t& opt = opts[k];
+            if (!opt.hasValue()) continue;
+            string key = opt.getOptionName();
+            string val = opt.getValue();
+            switch (format) {
+            case EXPORT_JSON:
+                out.append((first) ? "\n    ":",\n    ",(first) ? 5:6);
+                appendJsonString(out,key);
+                out.append(": ",2);
+                if (isJsonLiteral(val)) out.append(val);
+                else appendJsonString(out,val);
+                break;
+            case EXPORT_ENVIRONMENT:
+                for (size_t j=0; j<key.size(); ++j) {
+                    char ch = key[j];
+                    if (isalpha(ch)) {
+                        key[j] = toupper(ch);
+                    }
+                }
+                if (prefix.size()) key = prefix + "_" + key;
+                if (!isShellName(key)) {
+                    out.append("# cannot export ",16);
+                    out.append(opt.getOptionName());
+                    out.append('\n');
+                    break;
+                }
+                out.append("export ",7);
+                out.append(key);
+                out.append('=');
+                appendShellWord(out,val);
+                out.append('\n');
+                break;
+            case EXPORT_OPTION_FILE:
+                if (key.empty() || key[0]=='!' || key[0]=='#' || key[0]=='[' || key[0]=='"' || key[0]=='\'' ||
+                        key.find('\\')!=string::npos ||
+                        find_if(key.begin(),key.end(),isOptionDelimiter)!=key.end()) {
+                    out.append("# cannot write option ",22);
+                    out.append(key);
+                    out.append('\n');
+                    break;
+                }
+                out.append(key);
+                out.append(" = ",3);
+                appendOptionValue(out,val);
+                out.append('\n');
+                break;
+            }
+            first = false;
+        }
+        if (format==EXPORT_JSON) out.append((first) ? "}\n":"\n}\n",(first) ? 2:3);
+    }
+    ;
+
+    //!
+    //! \brief write every option which has a value to the file filename in the given format
+    //!  (see exportOptions). Throws SystemError if the file cannot be written.
+    //!
+    void exportOptions(const string& filename,export_format_t format,const string& prefix=string("")) const
+    {
+        OutputBuffer out(64*opts.size()+64);
+        exportOptions(out,format,prefix);
+        out.writeTo(filename);
+    }
+    ;
+
+    //!
+    //! \brief print out the options (name,descriptions and values) then exit.
+    //!
+    void printHelp() const
+    {
+        std::cerr << "Usage is:\n";
+        // the help is also printed for values which cannot be converted, report those and go on
+        ProgramOptions *self = const_cast<ProgramOptions*>(this);
+        for (size_t k=0; k<opts.size(); ++k) {
+            if (!opts[k].isStale()) continue;
+            try {
+                self->resolveOption(k);
+            }
+            catch (exception& e) {
+                cerr << "ProgramOption::printHelp exception " << e.what() << endl;
+            }
+        }
+        const_iterator iter=opts.begin();
+        const_iterator iend=opts.end();
+        for (; iter!=iend; ++iter) {
+            iter->write2Stream(cerr);
+        }
+        exit(EXIT_FAILURE);
+    };
+
+protected:
+    //!
+    //! \brief add value to the "user" layer for option k
+    //!
+    void setUserValue(size_t k, const string& value)
+    {
+        size_t li = findLayer("user");
+        layer_values_t& vals = layers[li].values;
+        layer_values_t::iterator pos = lower_bound(vals.begin(),vals.end(),make_pair(k,string()),lessIndex);
+        if (pos!=vals.end() && pos->first==k) return;
+        pos = vals.insert(pos,make_pair(k,value));
+        try {
+            resolveOption(k);
+        }
+        catch (...) {
+            vals.erase(pos);
+            throw;
+        }
+        notifyChanges();
+    }
+    ;
+
+    //!
+    //! \brief report a handle from another ProgramOptions or out of range, unless NDEBUG is defined
+    //!
+    void checkHandle(const OptionHandle& handle) const throw ()
+    {
+#ifndef NDEBUG
+        if (handle.generation!=generation || handle.index>=opts.size()) {
+            cerr << "ProgramOption invalid option handle " << handle.index << ":" << handle.generation << endl;
+            printHelp();
+        }
+#else
+        (void)handle;
+#endif
+    }
+    ;
+
+    //!
+    //! \brief the option of handle, resolved first in lazy mode, which throws if a bound option
+    //!  cannot take its value
+    //!
+    const option_t& resolvedOption(const OptionHandle& handle) const
+    {
+        checkHandle(handle);
+        const option_t& opt = opts[handle.index];
+        if (opt.isStale()) const_cast<ProgramOptions*>(this)->resolveOption(handle.index);
+        return opt;
+    }
+    ;
+
+    static unsigned int nextGeneration() throw ()
+    {
+        static atomic<unsigned int> counter(0);
+        return ++counter;
+    }
+    ;
+
+    //!
+    //! \brief split the text of an option file into name value pairs (see OptionTokenizer). A name
+    //!  with no value is given the value true.
+    //!
+    static void splitOptionText(const char *data,size_t len,vector< pair<string,string> >& pairs)
+    {
+        OptionTokenizer::forEachOption(data,len,[&](const OptionToken& key,const OptionToken& value,size_t) {
+            pairs.push_back(make_pair(OptionTokenizer::text(key),OptionTokenizer::text(value)));
+        });
+    };
+
+    //!
+    //! \brief split the option file into chunks at line boundaries, tokenize them in parallel and
+    //!  join the results in file order into vals, as parseOptionFile would build them serially.
+    //!
+    //!  Each chunk keeps the first value of each option and sorts them, then the chunks are merged
+    //!  taking, for each option, the value from the earliest chunk. Only the merge is serial and its
+    //!  size is bounded by the number of distinct options in each chunk, not by the lines. As in a
+    //!  serial parse the first malformed line in the file is reported, with its line in the file,
+    //!  before any unknown name.
+    //!
+    void splitOptionFileParallel(const string& options_filename,layer_values_t& vals)
+    {
+        MappedFile file(options_filename);
+        const char *data = file.data();
+        size_t len = file.size();
+        size_t nw = parse_threads;
+        if (nw==0) nw = thread::hardware_concurrency();
+        if (nw==0) nw = 1;
+        // a few chunks per thread evens out lines of differing cost
+        size_t target = len/(4*nw)+1;
+        vector<size_t> starts(1,0);
+        while (len-starts.back()>target) {
+            // split after a line break which does not continue the line
+            size_t from = starts.back()+target;
+            const char *nl;
+            do {
+                nl = static_cast<const char*>(memchr(data+from,'\n',len-from));
+                if (nl) from = nl+1-data;
+            } while (nl && !OptionTokenizer::isLineStart(data,from));
+            if (!nl || from==len) break;
+            starts.push_back(from);
+        }
+        starts.push_back(len);
+        size_t nchunks = starts.size()-1;
+
+        struct chunk_t {
+            layer_values_t vals;
+            vector<string> unknown;
+            const char *message;
+            size_t line;
+            exception_ptr error;
+            chunk_t():vals(),unknown(),message(0),line(0),error() {};
+        };
+        vector<chunk_t> chunks(nchunks);
+        {
+            size_t nthreads = (nw<nchunks) ? nw:nchunks;
+            ThreadPool pool(nthreads);
+            atomic<size_t> next_chunk(0);
+            for (size_t w=0; w<nthreads; ++w) {
+                pool.submit([this,&chunks,&starts,&next_chunk,data,nchunks]() {
+                    vector<bool> seen(opts.size(),false);
+                    string scratch;
+                    for (size_t c=next_chunk++; c<nchunks; c=next_chunk++) {
+                        chunk_t& chunk = chunks[c];
+                        try {
+                            OptionTokenizer::forEachOption(data+starts[c],starts[c+1]-starts[c],
+                            [&](const OptionToken& key,const OptionToken& value,size_t) {
+                                const char *name;
+                                size_t name_len;
+                                OptionTokenizer::view(key,scratch,name,name_len);
+                                size_t k;
+                                // unknown names are reported in file order when joining
+                                if (!findIndex(name,name_len,k)) chunk.unknown.push_back(string(name,name_len));
+                                else if (!seen[k]) {
+                                    // only the first value in the chunk can win, later ones are not converted
+                                    seen[k] = true;
+                                    chunk.vals.push_back(make_pair(k,OptionTokenizer::text(value)));
+                                }
+                            },
+                            [&](const char *message,size_t line) {
+                                // the line is counted from the start of the chunk, keep the first
+                                if (!chunk.message) {
+                                    chunk.message = message;
+                                    chunk.line = line;
+                                }
+                            });
+                        }
+                        catch (...) {
+                            chunk.error = current_exception();
+                        }
+                        for (size_t j=0; j<chunk.vals.size(); ++j) seen[chunk.vals[j].first] = false;
+                        sort(chunk.vals.begin(),chunk.vals.end(),lessIndex);
+                    }
+                });
+            }
+            pool.wait();
+        }
+        // a malformed line is reported before the unknown names of earlier chunks, as serially
+        for (size_t c=0; c<nchunks; ++c) {
+            if (chunks[c].error) rethrow_exception(chunks[c].error);
+            if (chunks[c].message) {
+                size_t lines = count(data,data+starts[c],'\n');
+                OptionTokenizer::throwError(chunks[c].message,lines+chunks[c].line);
+            }
+        }
+        for (size_t c=0; c<nchunks; ++c) {
+            for (size_t j=0; j<chunks[c].unknown.size(); ++j) {
+                const string& name = chunks[c].unknown[j];
+                if (!allow_unused_options) throw ParseError(options_filename+": ProgramOptions could not find the option "+name);
+                cerr << "option " << name << " not found\n";
+            }
+        }
+        // merge the sorted chunks, on equal options the earlier chunk wins
+        typedef pair<size_t,size_t> head_t;
+        priority_queue< head_t,vector<head_t>,greater<head_t> > heads;
+        vector<size_t> pos(nchunks,0);
+        size_t total = 0;
+        for (size_t c=0; c<nchunks; ++c) {
+            total += chunks[c].vals.size();
+            if (chunks[c].vals.size()) heads.push(head_t(chunks[c].vals[0].first,c));
+        }
+        vals.reserve(total);
+        while (!heads.empty()) {
+            size_t c = heads.top().second;
+            heads.pop();
+            pair<size_t,string>& v = chunks[c].vals[pos[c]];
+            if (vals.empty() || vals.back().first!=v.first) {
+                vals.push_back(pair<size_t,string>());
+                vals.back().first = v.first;
+                vals.back().second.swap(v.second);
+            }
+            if (++pos[c]<chunks[c].vals.size()) heads.push(head_t(chunks[c].vals[pos[c]].first,c));
+        }
+    };
+
+    static bool isOptionDelimiter(char ch) throw ()
+    {
+        return ch==' ' || ch=='=' || ch=='\t' || ch=='\n' || ch=='\r' || ch=='\f';
+    };
+
+    //!
+    //! \brief map an option file and record, for each option it names, where the value is
+    //!
+    void indexOptionFile(const string& options_filename)
+    {
+        shared_ptr<MappedFile> file(new MappedFile(options_filename));
+        vector<lazy_value_t> entries;
+        vector<string> errors;
+        string scratch;
+        OptionTokenizer::forEachOption(file->data(),file->size(),
+        [&](const OptionToken& key,const OptionToken& value,size_t line_no) {
+            const char *name;
+            size_t name_len;
+            OptionTokenizer::view(key,scratch,name,name_len);
+            size_t k;
+            if (!findIndex(name,name_len,k)) {
+                if (!allow_unused_options) {
+                    errors.push_back(options_filename+":"+type2string(line_no)+" unknown option "+string(name,name_len));
+                }
+                return;
+            }
+            lazy_value_t v;
+            v.k = k;
+            v.line = line_no;
+            v.token = value;
+            v.done = false;
+            entries.push_back(v);
+        },
+        [&](const char *message,size_t line_no) {
+            errors.push_back(options_filename+":"+type2string(line_no)+" "+message);
+        });
+        stable_sort(entries.begin(),entries.end(),lessLazy);
+        size_t n = 0;
+        for (size_t j=0; j<entries.size(); ++j) {
+            if (n && entries[n-1].k==entries[j].k) continue;
+            if (n!=j) entries[n] = entries[j];
+            ++n;
+        }
+        entries.resize(n);
+        layer_t& layer = layers[findLayer(options_filename)];
+        if (layer.lazy_env) {
+            for (size_t k=0; k<opts.size(); ++k) opts[k].markStale();
+        }
+        for (size_t j=0; j<layer.values.size(); ++j) opts[layer.values[j].first].markStale();
+        for (size_t j=0; j<layer.lazy.size(); ++j) opts[layer.lazy[j].k].markStale();
+        for (size_t j=0; j<entries.size(); ++j) opts[entries[j].k].markStale();
+        dropLazy(layer);
+        layer.values.clear();
+        layer.lazy.swap(entries);
+        layer.file = file;
+        layer.errors.swap(errors);
+    };
+
+    static bool lessLazy(const lazy_value_t& a,const lazy_value_t& b)
+    {
+        return a.k<b.k;
+    };
+
+    static void dropLazy(layer_t& layer)
+    {
+        layer.file.reset();
+        layer.lazy.clear();
+        layer.lazy_env = false;
+        layer.env_state.clear();
+        layer.env_values.clear();
+        layer.errors.clear();
+    };
+
+    //!
+    //! \brief the value layer li gives option k or null, converting a lazily indexed value if need be
+    //!
+    const string *layerValue(size_t li,size_t k)
+    {
+        layer_t& layer = layers[li];
+        if (!layer.isLazy()) return layer.find(k);
+        if (layer.lazy_env) {
+            if (k>=layer.env_state.size()) {
+                layer.env_state.resize(opts.size(),0);
+                layer.env_values.resize(opts.size());
+            }
+            if (layer.env_state[k]==0) {
+                string key = opts[k].getOptionName();
+                for (size_t j=0; j<key.size(); ++j) {
+                    char ch = key[j];
+                    if (isalpha(ch)) {
+                        key[j] = toupper(ch);
+                    }
+                }
+                if (layer.env_prefix.size()) key = layer.env_prefix + "_" + key;
+                char * ret=std::getenv(key.c_str());
+                layer.env_state[k] = (ret) ? 1:-1;
+                if (ret) layer.env_values[k] = ret;
+            }
+            return (layer.env_state[k]==1) ? &layer.env_values[k]:0;
+        }
+        size_t lo = 0;
+        size_t hi = layer.lazy.size();
+        while (lo<hi) {
+            size_t mid = (lo+hi)/2;
+            if (layer.lazy[mid].k<k) lo = mid+1;
+            else hi = mid;
+        }
+        if (lo==layer.lazy.size() || layer.lazy[lo].k!=k) return 0;
+        lazy_value_t& v = layer.lazy[lo];
+        if (!v.done) {
+            v.value = OptionTokenizer::text(v.token);
+            v.done = true;
+        }
+        return &v.value;
+    };
+
+    void bindOption(size_t k,const function<void(const string&)>& setter,string (*normalize)(const string&)=0)
+    {
+        if (opts[k].isStale()) resolveOption(k);
+        opts[k].bind(setter);
+        bound.push_back(k);
+        if (normalize) {
+            opts[k].setNormalizer(normalize);
+            opts[k].updatePrint(config_print);
+        }
+    };
+
+    //!
+    //! \brief the canonical text of a value of type T, so that e.g. 1.0 and 1e0 given for a double
+    //!  fingerprint alike. Floating point values keep every digit. A value which is not a T is
+    //!  returned as given; unlike string2type nothing is written to cerr.
+    //!
+    template<typename T>
+    static string normalizedValue(const string& value)
     {
-        const_iterator iter = opts.begin();
-        const_iterator iend = opts.end();
-        for (; iter != iend; ++iter) {
-            if (iter->matches(option_name))
-                return iter;
+        T x;
+        if (!convertQuietly(value,x)) return value;
+        return canonicalText(x);
+    };
+
+    //!
+    //! \brief convert value as string2type<T> does, returning false instead of reporting an error
+    //!
+    template<typename T>
+    static typename enable_if<is_integral<T>::value && is_signed<T>::value,bool>::type
+    convertQuietly(const string& value,T& x)
+    {
+        const char *arg = value.c_str();
+        char *end;
+        errno = 0;
+        long long k = strtoll(arg,&end,10);
+        if (arg==end || errno || k<numeric_limits<T>::min() || k>numeric_limits<T>::max()) return false;
+        x = static_cast<T>(k);
+        return true;
+    };
+
+    template<typename T>
+    static typename enable_if<is_integral<T>::value && !is_signed<T>::value,bool>::type
+    convertQuietly(const string& value,T& x)
+    {
+        const char *arg = value.c_str();
+        char *end;
+        errno = 0;
+        unsigned long long k = strtoull(arg,&end,10);
+        if (arg==end || errno || k>numeric_limits<T>::max()) return false;
+        x = static_cast<T>(k);
+        return true;
+    };
+
+    template<typename T>
+    static typename enable_if<is_floating_point<T>::value,bool>::type
+    convertQuietly(const string& value,T& x)
+    {
+        const char *arg = value.c_str();
+        char *end;
+        errno = 0;
+        double k = strtod(arg,&end);
+        if (arg==end || errno || k>numeric_limits<T>::max()) return false;
+        x = static_cast<T>(k);
+        return true;
+    };
+
+    template<typename T>
+    static typename enable_if<!is_arithmetic<T>::value,bool>::type
+    convertQuietly(const string& value,T& x)
+    {
+        istringstream is(value);
+        is >> x;
+        return true;
+    };
+
+    static bool convertQuietly(const string& value,bool& x)
+    {
+        if (value.empty()) return false;
+        char ch = value[0];
+        x = !(ch=='F' || ch=='f' || ch=='0' || ch=='N' || ch=='n');
+        return true;
+    };
+
+    static bool convertQuietly(const string& value,string& x)
+    {
+        x = value;
+        return true;
+    };
+
+    static string canonicalText(double x)
+    {
+        char buf[32];
+        int n = snprintf(buf,sizeof(buf),"%.17g",x);
+        return string(buf,n);
+    };
+
+    static string canonicalText(float x)
+    {
+        char buf[32];
+        int n = snprintf(buf,sizeof(buf),"%.9g",x);
+        return string(buf,n);
+    };
+
+    template<typename T>
+    static string canonicalText(const T& x)
+    {
+        return type2string(x);
+    };
+
+    //!
+    //! \brief resolve the bound and subscribed options waiting on a lazily indexed source, so that
+    //!  the variables they are bound to are current and their subscribers told of changes
+    //!
+    void refreshBound()
+    {
+        for (size_t j=0; j<bound.size(); ++j) {
+            if (opts[bound[j]].isStale()) resolveOption(bound[j]);
+        }
+        for (size_t id=0; id<subscribers.size(); ++id) {
+            const vector<size_t>& keys = subscribers[id].keys;
+            for (size_t j=0; j<keys.size(); ++j) {
+                if (opts[keys[j]].isStale()) resolveOption(keys[j]);
+            }
+        }
+        notifyChanges();
+    };
+
+    OptionHandle appendOption(const option_t& opt)
+    {
+        OptionHandle handle(opts.size(),generation);
+        index.insert(make_pair(name_view_t(opt.name().data(),opt.name().size()),opts.size()));
+        opts.push_back(opt);
+        opts.back().updatePrint(config_print);
+        for (size_t id=0; id<subscribers.size(); ++id) {
+            subscriber_t& sub = subscribers[id];
+            if (sub.callback && sub.by_prefix && opt.name().str().compare(0,sub.prefix.size(),sub.prefix)==0) {
+                watchers.resize(opts.size());
+                watchers[handle.index].push_back(id);
+                sub.keys.push_back(handle.index);
+            }
+        }
+        return handle;
+    };
+
+    size_t addSubscriber(const subscriber_t& sub)
+    {
+        size_t id = subscribers.size();
+        subscribers.push_back(sub);
+        watchers.resize(opts.size());
+        for (size_t j=0; j<sub.keys.size(); ++j) watchers[sub.keys[j]].push_back(id);
+        return id;
+    };
+
+    //!
+    //! \brief pass the options changed since the last call to their subscribers, one set each,
+    //!  unless a batch is open
+    //!
+    void notifyChanges()
+    {
+        if (batch_depth || changed.empty()) return;
+        vector<size_t> keys;
+        keys.swap(changed);
+        sort(keys.begin(),keys.end());
+        keys.erase(unique(keys.begin(),keys.end()),keys.end());
+        vector<size_t> ids;
+        for (size_t j=0; j<keys.size(); ++j) {
+            const option_t& opt = opts[keys[j]];
+            OptionChange change;
+            change.name = opt.getOptionName();
+            change.has_value = opt.hasValue();
+            if (change.has_value) change.value = opt.getValue();
+            const vector<size_t>& w = watchers[keys[j]];
+            for (size_t i=0; i<w.size(); ++i) {
+                subscriber_t& sub = subscribers[w[i]];
+                if (!sub.pending) {
+                    sub.pending.reset(new OptionChangeSet);
+                    ids.push_back(w[i]);
+                }
+                sub.pending->push_back(change);
+            }
+        }
+        if (ids.empty()) return;
+        if (!notifier) notifier.reset(new ThreadPool(1));
+        for (size_t i=0; i<ids.size(); ++i) {
+            shared_ptr<OptionChangeSet> set;
+            set.swap(subscribers[ids[i]].pending);
+            OptionChangeCallback f = subscribers[ids[i]].callback;
+            notifier->submit([f,set]() {
+                f(*set);
+            });
+        }
+    };
+
+    //!
+    //! \brief resolve every option waiting on a lazily indexed source
+    //!
+    void refreshAll() const
+    {
+        ProgramOptions *self = const_cast<ProgramOptions*>(this);
+        for (size_t k=0; k<opts.size(); ++k) {
+            if (opts[k].isStale()) self->resolveOption(k);
+        }
+    };
+
+    iterator findIterator(const string& option_name)
+    {
+        size_t k;
+        if (findIndex(option_name.data(),option_name.size(),k)) return opts.begin()+k;
+        string err("ProgramOptions could not find the option ");
+        err += option_name;
+        err += "\n";
+        throw runtime_error(err);
+    }
+    ;
+    const_iterator findConstIterator(const string& option_name) const
+    {
+        size_t k;
+        if (findIndex(option_name.data(),option_name.size(),k)) {
+            if (opts[k].isStale()) const_cast<ProgramOptions*>(this)->resolveOption(k);
+            return opts.begin()+k;
         }
         string err("ProgramOptions could not find the option ");
         err += option_name;
@@ -477,6 +1946,151 @@ protected:
         throw runtime_error(err);
     }
     ;
+
+    //!
+    //! \brief find the index of the option named [name,name+len). The index is private to this
+    //!  ProgramOptions, so lookups take no lock.
+    //!
+    bool findIndex(const char *name,size_t len,size_t& k) const
+    {
+        index_t::const_iterator iter = index.find(name_view_t(name,len));
+        if (iter==index.end()) return false;
+        k = iter->second;
+        return true;
+    }
+    ;
+
+    //!
+    //! \brief find the index of option_name. Unknown names are reported and false returned when
+    //!  unused options are allowed, otherwise the help is printed.
+    //!
+    bool lookupOption(const string& option_name,size_t& k)
+    {
+        if (findIndex(option_name.data(),option_name.size(),k)) return true;
+        if (allow_unused_options) {
+            cerr << "option " << option_name << " not found\n";
+            return false;
+        }
+        cerr << "ProgramOption::setValue exception ProgramOptions could not find the option " << option_name << endl;
+        printHelp();
+        return false;
+    }
+    ;
+
+    //!
+    //! \brief append a value for option_name to the values of a layer being built
+    //!
+    void addValue(layer_values_t& vals,const string& option_name,const string& value)
+    {
+        size_t k;
+        if (lookupOption(option_name,k)) vals.push_back(make_pair(k,value));
+    }
+    ;
+
+    static bool lessIndex(const pair<size_t,string>& a,const pair<size_t,string>& b)
+    {
+        return a.first<b.first;
+    }
+    ;
+
+    //!
+    //! \brief return the index of the named layer, adding it below the existing ones if need be
+    //!
+    size_t findLayer(const string& name)
+    {
+        for (size_t li=0; li<layers.size(); ++li) {
+            if (layers[li].name==name) return li;
+        }
+        layers.push_back(layer_t(name));
+        return layers.size()-1;
+    }
+    ;
+
+    //!
+    //! \brief replace the values of layer li and re-resolve only the options it gave or now gives.
+    //!  vals is consumed. When a name appears more than once the first value is kept. When a bound
+    //!  option cannot take its new value the layer and the options are put back as they were and
+    //!  the exception is rethrown.
+    //!
+    void replaceLayer(size_t li,layer_values_t& vals)
+    {
+        stable_sort(vals.begin(),vals.end(),lessIndex);
+        size_t n = 0;
+        for (size_t j=0; j<vals.size(); ++j) {
+            if (n && vals[n-1].first==vals[j].first) continue;
+            if (n!=j) vals[n].swap(vals[j]);
+            ++n;
+        }
+        vals.resize(n);
+        bool was_lazy = layers[li].isLazy();
+        shared_ptr<layer_t> saved;
+        if (was_lazy) {
+            saved.reset(new layer_t(layers[li]));
+            // rare, a lazily indexed source parsed again eagerly
+            dropLazy(layers[li]);
+            for (size_t k=0; k<opts.size(); ++k) opts[k].markStale();
+        }
+        layer_values_t& old = layers[li].values;
+        vector<size_t> touched;
+        touched.reserve(old.size()+vals.size());
+        size_t i = 0;
+        size_t j = 0;
+        while (i<old.size() || j<vals.size()) {
+            if (j==vals.size() || (i<old.size() && old[i].first<vals[j].first)) touched.push_back(old[i++].first);
+            else if (i==old.size() || vals[j].first<old[i].first) touched.push_back(vals[j++].first);
+            else {
+                touched.push_back(old[i].first);
+                ++i;
+                ++j;
+            }
+        }
+        old.swap(vals);
+        size_t nchanged = changed.size();
+        size_t t = 0;
+        try {
+            for (; t<touched.size(); ++t) resolveOption(touched[t]);
+            // the options the index gave are not in touched, keep the bound ones current
+            if (was_lazy) refreshBound();
+        }
+        catch (...) {
+            // resolving again from the layer as it was cannot fail where it did not before
+            if (saved) {
+                layers[li] = *saved;
+                for (size_t k=0; k<opts.size(); ++k) opts[k].markStale();
+                for (size_t j=0; j<bound.size(); ++j) resolveOption(bound[j]);
+            }
+            else {
+                layers[li].values.swap(vals);
+            }
+            for (size_t u=0; u<t; ++u) resolveOption(touched[u]);
+            changed.resize(nchanged);
+            throw;
+        }
+        notifyChanges();
+    }
+    ;
+
+    //!
+    //! \brief recompute the value of option k from the layers. The earliest layer giving a value
+    //!  wins, then the default.
+    //!
+    void resolveOption(size_t k)
+    {
+        bool was_changed = false;
+        size_t li = 0;
+        for (; li<layers.size(); ++li) {
+            const string *v = layerValue(li,k);
+            if (v) {
+                was_changed = opts[k].resolve(v,int(li),intern_values);
+                break;
+            }
+        }
+        if (li==layers.size()) was_changed = opts[k].resolve(0,-1);
+        if (was_changed) opts[k].updatePrint(config_print);
+        // only options someone subscribed to are recorded
+        if (was_changed && k<watchers.size() && watchers[k].size()) changed.push_back(k);
+    }
+    ;
 }; // end class defn.
 
 } // end namespace putils
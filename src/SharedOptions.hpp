@@ -0,0 +1,572 @@
+/*
+ * SharedOptions.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SHAREDOPTIONS_HPP_
+#define SHAREDOPTIONS_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+extern "C" {
+#include <sys/mman.h>
+}
+#include "putils.hpp"
+#include "ProgramOptions.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief the start of a shared option segment. Only the publisher writes it.
+//!
+//!  sequence is odd while a table is being published and the generation is sequence/2. Tables are
+//!  written to two slots in turn, so the table of sequence s is overwritten once sequence reaches
+//!  s+3, which a reader checks after reading it.
+//!
+struct SharedOptionHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    atomic<uint64_t> sequence;
+    atomic<uint64_t> table_offset;
+    atomic<uint64_t> table_size;
+};
+
+//!
+//! \brief one option of a published table. Offsets are from the start of the table, so the table
+//!  reads the same wherever it is mapped. Names and values are also followed by a 0.
+//!
+struct SharedOptionEntry {
+    uint64_t name_offset;
+    uint64_t value_offset;
+    uint32_t name_len;
+    uint32_t value_len;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+//!
+//! \brief the start of a published table, followed by the entries sorted by name and the text
+//!
+struct SharedOptionTable {
+    char magic[8];
+    uint64_t count;
+    uint64_t entries_offset;
+    uint64_t generation;
+};
+
+enum { SHARED_OPTION_HAS_VALUE = 1, SHARED_OPTION_WAS_SET = 2 };
+
+//!
+//! \brief publishes the resolved options of a ProgramOptions for other processes to read.
+//!
+//!  The segment is a memfd, which children made by fork inherit (pass descriptor() to exec'd
+//!  children, e.g. in an environment variable), or the POSIX shared memory object shm_name. A
+//!  segment already under that name is unlinked rather than truncated, so readers attached to it
+//!  keep what they mapped. Each publish writes the table to one of two slots in turn and then moves
+//!  the generation on, which readers check with SharedOptionView::refresh. A slot is only moved to
+//!  the end of the segment when a table outgrows it, so the segment stays within a few times the
+//!  largest table. A memfd is sealed against shrinking so no reader can be cut short.
+//!
+class SharedOptionPublisher {
+public:
+    enum { HEADER_SIZE = 4096, TABLE_ALIGN = 64 };
+
+    explicit SharedOptionPublisher(const string& shm_name_in=string()):shm_name(shm_name_in),fd(-1),header(0),end(HEADER_SIZE)
+    {
+        for (int s=0; s<2; ++s) {
+            slot_offset[s] = 0;
+            slot_capacity[s] = 0;
+        }
+        if (shm_name.empty()) fd = memfd_create("putils-options",MFD_ALLOW_SEALING);
+        else {
+            // a segment left under the name may still be mapped by readers, replace it
+            fd = shm_open(shm_name.c_str(),O_CREAT|O_EXCL|O_RDWR,0644);
+            if (fd==-1 && errno==EEXIST && shm_unlink(shm_name.c_str())==0) {
+                fd = shm_open(shm_name.c_str(),O_CREAT|O_EXCL|O_RDWR,0644);
+            }
+        }
+        if (fd==-1) throw SystemError(string("SharedOptionPublisher could not create ")+segmentName(),errno);
+        if (ftruncate(fd,HEADER_SIZE)==-1) fail("size");
+        if (shm_name.empty() && fcntl(fd,F_ADD_SEALS,F_SEAL_SHRINK)==-1) fail("seal");
+        void *p = mmap(0,HEADER_SIZE,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+        if (p==MAP_FAILED) fail("map");
+        header = new (p) SharedOptionHeader;
+        memcpy(header->magic,"PUTLOPTS",8);
+        header->version = 1;
+        header->header_size = HEADER_SIZE;
+        header->sequence.store(0,memory_order_relaxed);
+        header->table_offset.store(0,memory_order_relaxed);
+        header->table_size.store(0,memory_order_release);
+    };
+
+    virtual ~SharedOptionPublisher()
+    {
+        if (header) munmap(header,HEADER_SIZE);
+        if (fd!=-1) close(fd);
+    };
+
+    //!
+    //! \brief the descriptor readers attach to
+    //!
+    int descriptor() const throw ()
+    {
+        return fd;
+    };
+
+    //!
+    //! \brief the generation of the last table published, 0 before the first
+    //!
+    uint64_t generation() const throw ()
+    {
+        return header->sequence.load(memory_order_relaxed)/2;
+    };
+
+    //!
+    //! \brief write the options which have a value, as resolved now, as a new table and make it the
+    //!  current one. Returns its generation. The table two generations back is overwritten. Throws
+    //!  SystemError if the segment cannot grow or be written, leaving the current table in place
+    //!  and the publisher usable.
+    //!
+    uint64_t publish(const ProgramOptions& options)
+    {
+        vector<string> names = options.getOptionNames();
+        vector<item_t> items;
+        items.reserve(names.size());
+        for (size_t k=0; k<names.size(); ++k) {
+            if (!options.hasValue(names[k])) continue;
+            item_t item;
+            item.name = names[k];
+            item.value = options.getValue(names[k]);
+            item.flags = SHARED_OPTION_HAS_VALUE | ((options.wasSet(names[k])) ? SHARED_OPTION_WAS_SET:0);
+            items.push_back(item);
+        }
+        sort(items.begin(),items.end(),lessName);
+        uint64_t gen = generation()+1;
+
+        size_t entries_offset = sizeof(SharedOptionTable);
+        size_t text_offset = entries_offset+items.size()*sizeof(SharedOptionEntry);
+        size_t text_size = 0;
+        for (size_t k=0; k<items.size(); ++k) text_size += items[k].name.size()+items[k].value.size()+2;
+        string table(text_offset+text_size,'\0');
+        SharedOptionTable th;
+        memcpy(th.magic,"PUTLOTAB",8);
+        th.count = items.size();
+        th.entries_offset = entries_offset;
+        th.generation = gen;
+        memcpy(&table[0],&th,sizeof(th));
+        size_t pos = text_offset;
+        for (size_t k=0; k<items.size(); ++k) {
+            SharedOptionEntry e;
+            e.name_offset = pos;
+            e.name_len = items[k].name.size();
+            memcpy(&table[pos],items[k].name.data(),e.name_len);
+            pos += e.name_len+1;
+            e.value_offset = pos;
+            e.value_len = items[k].value.size();
+            memcpy(&table[pos],items[k].value.data(),e.value_len);
+            pos += e.value_len+1;
+            e.flags = items[k].flags;
+            e.reserved = 0;
+            memcpy(&table[entries_offset+k*sizeof(e)],&e,sizeof(e));
+        }
+
+        int slot = int(gen&1);
+        if (table.size()>slot_capacity[slot]) {
+            // move the slot to the end, with room for the table to grow
+            size_t new_offset = align(end);
+            size_t new_capacity = align(2*table.size());
+            if (ftruncate(fd,new_offset+new_capacity)==-1) error("grow");
+            slot_offset[slot] = new_offset;
+            slot_capacity[slot] = new_capacity;
+            end = new_offset+new_capacity;
+        }
+        size_t offset = slot_offset[slot];
+
+        // readers of the table in the slot see the odd sequence before any of it changes
+        uint64_t seq = header->sequence.load(memory_order_relaxed);
+        header->sequence.store(seq+1,memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        size_t done = 0;
+        while (done<table.size()) {
+            ssize_t n = pwrite(fd,table.data()+done,table.size()-done,offset+done);
+            if (n<0 && errno==EINTR) continue;
+            if (n<0) {
+                // the slot may be part written, so its old table is given up: the sequence moves
+                // on while the current table stays
+                int e = errno;
+                header->sequence.store(seq+2,memory_order_release);
+                errno = e;
+                error("write");
+            }
+            done += n;
+        }
+        header->table_offset.store(offset,memory_order_relaxed);
+        header->table_size.store(table.size(),memory_order_relaxed);
+        header->sequence.store(seq+2,memory_order_release);
+        return gen;
+    };
+
+    //!
+    //! \brief remove the name of a shm_open segment; attached readers keep their mappings
+    //!
+    void unlink()
+    {
+        if (shm_name.size()) shm_unlink(shm_name.c_str());
+    };
+
+private:
+    SharedOptionPublisher(const SharedOptionPublisher&);
+    SharedOptionPublisher& operator=(const SharedOptionPublisher&);
+
+    struct item_t {
+        string name;
+        string value;
+        uint32_t flags;
+    };
+
+    string shm_name;
+    int fd;
+    SharedOptionHeader *header;
+    size_t end;
+    size_t slot_offset[2];
+    size_t slot_capacity[2];
+
+    static size_t align(size_t n) throw ()
+    {
+        return (n+TABLE_ALIGN-1)/TABLE_ALIGN*TABLE_ALIGN;
+    };
+
+    static bool lessName(const item_t& a,const item_t& b)
+    {
+        return a.name<b.name;
+    };
+
+    string segmentName() const
+    {
+        return (shm_name.size()) ? shm_name:string("memfd");
+    };
+
+    //!
+    //! \brief throw the error of a publish, keeping the segment for the next one
+    //!
+    void error(const char *what)
+    {
+        throw SystemError(string("SharedOptionPublisher could not ")+what+" "+segmentName(),errno);
+    };
+
+    //!
+    //! \brief throw the error of the constructor, closing the segment
+    //!
+    void fail(const char *what)
+    {
+        int e = errno;
+        if (fd!=-1) close(fd);
+        fd = -1;
+        throw SystemError(string("SharedOptionPublisher could not ")+what+" "+segmentName(),e);
+    };
+};
+
+//!
+//! \brief reads a table of options published by a SharedOptionPublisher, in place.
+//!
+//!  Nothing is copied or parsed: a lookup is a binary search of the mapped table and the values
+//!  returned point into it. refresh switches to a newer table when one has been published. The
+//!  publisher reuses the space of a table two generations later, so a pointer returned stays valid
+//!  only until two more tables have been published; getValue, hasValue and wasSet notice when the
+//!  table they read was replaced meanwhile and read the newest one instead. The table and each
+//!  entry are checked against the mapped segment before use, so a damaged segment throws
+//!  ParseError rather than reading outside it.
+//!
+class SharedOptionView {
+public:
+    //!
+    //! \brief attach to the segment open on fd, which is duplicated
+    //!
+    explicit SharedOptionView(int fd_in):fd(dup(fd_in)),table(0),seq(0),table_size(0),count(0),entries_offset(0),gen(0)
+    {
+        if (fd==-1) throw SystemError(string("SharedOptionView could not use descriptor"),errno);
+        attach();
+    };
+
+    //!
+    //! \brief attach to the POSIX shared memory object shm_name
+    //!
+    explicit SharedOptionView(const string& shm_name):fd(shm_open(shm_name.c_str(),O_RDONLY,0)),table(0),seq(0),table_size(0),count(0),entries_offset(0),gen(0)
+    {
+        if (fd==-1) throw SystemError(string("SharedOptionView could not open ")+shm_name,errno);
+        attach();
+    };
+
+    virtual ~SharedOptionView()
+    {
+        for (size_t k=0; k<maps.size(); ++k) munmap(maps[k].first,maps[k].second);
+        close(fd);
+    };
+
+    //!
+    //! \brief whether a table newer than the one in use has been published, without switching
+    //!
+    bool republished() const throw ()
+    {
+        return header()->sequence.load(memory_order_acquire)!=seq;
+    };
+
+    //!
+    //! \brief switch to the newest table. Returns true if it is not the one in use. Throws ParseError
+    //!  if the table does not fit the segment or is not an option table.
+    //!
+    bool refresh()
+    {
+        return update();
+    };
+
+    uint64_t generation() const throw ()
+    {
+        return gen;
+    };
+
+    size_t size() const throw ()
+    {
+        return count;
+    };
+
+    //!
+    //! \brief find the option named [name,name+len). value points at its value, followed by a 0.
+    //!
+    bool find(const char *name,size_t len,const char *& value,size_t& value_len) const
+    {
+        SharedOptionEntry e;
+        if (!lookup(name,len,e)) return false;
+        value = table+e.value_offset;
+        value_len = e.value_len;
+        return true;
+    };
+
+    //!
+    //! \brief the value of option_name, null if it had none when published
+    //!
+    const char *value(const string& option_name) const
+    {
+        SharedOptionEntry e;
+        return (lookup(option_name.data(),option_name.size(),e)) ? table+e.value_offset:0;
+    };
+
+    string getValue(const string& option_name) const
+    {
+        for (;;) {
+            SharedOptionEntry e;
+            bool found = findEntry(option_name.data(),option_name.size(),e);
+            string v = (found) ? string(table+e.value_offset,e.value_len):string("");
+            if (current()) return v;
+            update();
+        }
+    };
+
+    bool hasValue(const string& option_name) const
+    {
+        SharedOptionEntry e;
+        return lookup(option_name.data(),option_name.size(),e);
+    };
+
+    bool wasSet(const string& option_name) const
+    {
+        SharedOptionEntry e;
+        return lookup(option_name.data(),option_name.size(),e) && (e.flags&SHARED_OPTION_WAS_SET);
+    };
+
+    //!
+    //! \brief the name and value of the k-th option in name order, null if there is none
+    //!
+    const char *nameAt(size_t k) const throw ()
+    {
+        SharedOptionEntry e;
+        return (entryAt(k,e)) ? table+e.name_offset:0;
+    };
+
+    const char *valueAt(size_t k) const throw ()
+    {
+        SharedOptionEntry e;
+        return (entryAt(k,e)) ? table+e.value_offset:0;
+    };
+
+private:
+    SharedOptionView(const SharedOptionView&);
+    SharedOptionView& operator=(const SharedOptionView&);
+
+    int fd;
+    mutable vector< pair<void*,size_t> > maps;
+    mutable const char *table;
+    mutable uint64_t seq;
+    mutable uint64_t table_size;
+    mutable uint64_t count;
+    mutable uint64_t entries_offset;
+    mutable uint64_t gen;
+
+    void attach()
+    {
+        map();
+        const SharedOptionHeader *h = header();
+        if (memcmp(h->magic,"PUTLOPTS",8)!=0 || h->version!=1) {
+            throw ParseError(string("SharedOptionView found no option segment"));
+        }
+        update();
+    };
+
+    //!
+    //! \brief map the whole segment as it is now. The mapping before stays for the values in it,
+    //!  older ones are unmapped.
+    //!
+    void map() const
+    {
+        struct stat st;
+        if (fstat(fd,&st)==-1) throw SystemError(string("SharedOptionView could not stat segment"),errno);
+        if (size_t(st.st_size)<sizeof(SharedOptionHeader)) throw ParseError(string("SharedOptionView found no option segment"));
+        void *p = mmap(0,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+        if (p==MAP_FAILED) throw SystemError(string("SharedOptionView could not map segment"),errno);
+        while (maps.size()>1) {
+            munmap(maps.front().first,maps.front().second);
+            maps.erase(maps.begin());
+        }
+        maps.push_back(make_pair(p,size_t(st.st_size)));
+    };
+
+    const SharedOptionHeader *header() const throw ()
+    {
+        return static_cast<const SharedOptionHeader*>(maps.back().first);
+    };
+
+    //!
+    //! \brief a consistent sequence, offset and size, waiting out a publish in progress
+    //!
+    void readHeader(uint64_t& s,uint64_t& offset,uint64_t& size) const throw ()
+    {
+        const SharedOptionHeader *h = header();
+        for (;;) {
+            s = h->sequence.load(memory_order_acquire);
+            if (s&1) {
+                sched_yield();
+                continue;
+            }
+            offset = h->table_offset.load(memory_order_relaxed);
+            size = h->table_size.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (h->sequence.load(memory_order_relaxed)==s) return;
+        }
+    };
+
+    //!
+    //! \brief whether the table at sequence s has not been overwritten since it was read
+    //!
+    bool unchanged(uint64_t s) const throw ()
+    {
+        atomic_thread_fence(memory_order_acquire);
+        return header()->sequence.load(memory_order_relaxed)<s+3;
+    };
+
+    bool current() const throw ()
+    {
+        return unchanged(seq);
+    };
+
+    //!
+    //! \brief whether [offset,offset+size) lies in the latest mapping after the header
+    //!
+    bool fits(uint64_t offset,uint64_t size) const throw ()
+    {
+        size_t mapped = maps.back().second;
+        return offset>=sizeof(SharedOptionHeader) && offset%8==0 && offset<=mapped && size<=mapped-offset;
+    };
+
+    bool update() const
+    {
+        for (;;) {
+            uint64_t s;
+            uint64_t offset;
+            uint64_t size;
+            readHeader(s,offset,size);
+            if (s==seq) return false;
+            if (!fits(offset,size)) map();
+            bool ok = fits(offset,size);
+            SharedOptionTable th;
+            const char *t = static_cast<const char*>(maps.back().first)+offset;
+            if (ok) {
+                ok = size>=sizeof(th);
+                if (ok) memcpy(&th,t,sizeof(th));
+                ok = ok && memcmp(th.magic,"PUTLOTAB",8)==0 && th.entries_offset>=sizeof(th) && th.entries_offset%8==0 &&
+                    th.entries_offset<=size && th.count<=(size-th.entries_offset)/sizeof(SharedOptionEntry);
+            }
+            // a table overwritten while it was checked is not damaged, read the newer one
+            if (!unchanged(s)) continue;
+            if (!ok) throw ParseError(string("SharedOptionView found no option table"));
+            table = t;
+            seq = s;
+            table_size = size;
+            count = th.count;
+            entries_offset = th.entries_offset;
+            gen = th.generation;
+            return true;
+        }
+    };
+
+    //!
+    //! \brief whether [offset,offset+len] lies in the table and ends with a 0
+    //!
+    bool validText(uint64_t offset,uint64_t len) const throw ()
+    {
+        return offset<table_size && len<table_size-offset && table[offset+len]==0;
+    };
+
+    //!
+    //! \brief copy the k-th entry to e, false if there is none or it does not fit the table
+    //!
+    bool entryAt(size_t k,SharedOptionEntry& e) const throw ()
+    {
+        if (!table || k>=count) return false;
+        memcpy(&e,table+entries_offset+k*sizeof(e),sizeof(e));
+        return validText(e.name_offset,e.name_len) && validText(e.value_offset,e.value_len);
+    };
+
+    bool findEntry(const char *name,size_t len,SharedOptionEntry& e) const throw ()
+    {
+        size_t lo = 0;
+        size_t hi = count;
+        while (lo<hi) {
+            size_t mid = (lo+hi)/2;
+            if (!entryAt(mid,e)) return false;
+            size_t n = (e.name_len<len) ? e.name_len:len;
+            int c = memcmp(table+e.name_offset,name,n);
+            if (c==0) c = (e.name_len<len) ? -1:((e.name_len>len) ? 1:0);
+            if (c==0) return true;
+            if (c<0) lo = mid+1;
+            else hi = mid;
+        }
+        return false;
+    };
+
+    //!
+    //! \brief findEntry in the newest table if the one in use was overwritten during the search
+    //!
+    bool lookup(const char *name,size_t len,SharedOptionEntry& e) const
+    {
+        for (;;) {
+            bool found = findEntry(name,len,e);
+            if (current()) return found;
+            update();
+        }
+    };
+};
+
+}
+#endif /* SHAREDOPTIONS_HPP_ */
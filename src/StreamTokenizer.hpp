@@ -0,0 +1,229 @@
+/*
+ * StreamTokenizer.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef STREAMTOKENIZER_HPP_
+#define STREAMTOKENIZER_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+extern "C" {
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+}
+#include <unistd.h>
+#include "putils.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief splits the contents of a file descriptor or istream into tokens without reading the whole input.
+//!
+//!  The input is pulled through a fixed size buffer which is refilled with large reads as tokens are
+//!  consumed, so the memory used does not depend upon the size of the input. A token that straddles the
+//!  end of the buffer is moved to the front of the buffer before the next read. A single token can not be
+//!  longer than the buffer. The hasTokens, nextToken and nextElement methods behave as in StringTokenizer.
+//!
+class StreamTokenizer {
+public:
+    enum { DEFAULT_BUFFER_SIZE = 1<<20 };
+
+    //!
+    //! \brief tokenize the data read from the open file descriptor fd. The descriptor is not closed.
+    //!
+    StreamTokenizer(int fd_in,const string& delimiters_in,size_t buffer_size=DEFAULT_BUFFER_SIZE):
+        fd(fd_in),is(0),owns_fd(false)
+    {
+        init(delimiters_in,buffer_size);
+        adviseSequential();
+    };
+    //!
+    //! \brief tokenize the data read from the given input stream.
+    //!
+    StreamTokenizer(istream& is_in,const string& delimiters_in,size_t buffer_size=DEFAULT_BUFFER_SIZE):
+        fd(-1),is(&is_in),owns_fd(false)
+    {
+        init(delimiters_in,buffer_size);
+    };
+    //!
+    //! \brief open the named file and tokenize its contents
+    //!
+    StreamTokenizer(const string& filename,const string& delimiters_in,size_t buffer_size=DEFAULT_BUFFER_SIZE):
+        fd(-1),is(0),owns_fd(true)
+    {
+        errno = 0;
+        fd = open(filename.c_str(),O_RDONLY);
+        if (fd==-1) {
+            string err("StreamTokenizer could not open ");
+            err += filename;
+            throw SystemError(err,errno);
+        }
+        init(delimiters_in,buffer_size);
+        adviseSequential();
+    };
+
+    virtual ~StreamTokenizer()
+    {
+        free(buf);
+        if (owns_fd) close(fd);
+    };
+    //!
+    //! \brief change the delimiters to use for splitting the remaining input
+    //!
+    void setDelimiters(const string& new_delimiters)
+    {
+        memset(isdel,0,sizeof(isdel));
+        const string& d = (new_delimiters.size()) ? new_delimiters:DEFAULT_DELIMITERS;
+        for (size_t k=0; k<d.size(); ++k) isdel[static_cast<unsigned char>(d[k])] = 1;
+    };
+    //!
+    //! \brief resets the delimiters to the default one \n \r \t\ \f and space characters.
+    //!
+    void setDelimiters()
+    {
+        setDelimiters(DEFAULT_DELIMITERS);
+    };
+    //!
+    //! \brief return true if there are more tokens to extract. May read more input.
+    //!
+    bool hasTokens()
+    {
+        return skipDelimiters();
+    };
+    //!
+    //! \brief return the next token in the sequence and advance the counter.
+    //!
+    string nextToken()
+    {
+        const char *token;
+        size_t len = nextToken(token);
+        return string(token,len);
+    };
+    //!
+    //! \brief point token at the next token in the buffer and return its length.
+    //!  The token is only valid until the next call which advances the tokenizer.
+    //!
+    size_t nextToken(const char *& token)
+    {
+        if (!skipDelimiters()) {
+            string err("StreamTokenizer::nextToken tried to get token past end of stream");
+            throw runtime_error(err);
+        }
+        size_t pos = first;
+        for (;;) {
+            while (pos<last && !isdel[static_cast<unsigned char>(buf[pos])]) ++pos;
+            if (pos<last || at_eof) break;
+            // token runs off the end of the buffer so slide it to the front and read more
+            size_t len = last-first;
+            if (len==cap) {
+                string err("StreamTokenizer::nextToken token is longer than the buffer");
+                throw ParseError(err);
+            }
+            if (first) {
+                memmove(buf,buf+first,len);
+                first = 0;
+                last = pos = len;
+            }
+            refill();
+        }
+        token = buf+first;
+        size_t len = pos-first;
+        first = pos;
+        return len;
+    };
+    //!
+    //! \brief  return the next token as a specified type and advance the counter
+    //!
+    template < class T > T nextElement()
+    {
+        string token=nextToken();
+        return string2type<T>(token);
+    };
+    //!
+    //! \brief return the number of bytes read from the input so far
+    //!
+    size_t bytesRead() const throw()
+    {
+        return nread;
+    };
+
+private:
+    StreamTokenizer(const StreamTokenizer&);
+    StreamTokenizer& operator=(const StreamTokenizer&);
+
+    int fd;
+    istream *is;
+    bool owns_fd;
+    bool at_eof;
+    char *buf;
+    size_t cap;
+    size_t first;
+    size_t last;
+    size_t nread;
+    unsigned char isdel[256];
+
+    void init(const string& delimiters_in,size_t buffer_size)
+    {
+        cap = (buffer_size) ? buffer_size:size_t(DEFAULT_BUFFER_SIZE);
+        buf = static_cast<char*>(Malloc(cap));
+        first = last = nread = 0;
+        at_eof = false;
+        setDelimiters(delimiters_in);
+    };
+
+    void adviseSequential()
+    {
+#ifdef POSIX_FADV_SEQUENTIAL
+        // only a hint, pipes and sockets return ESPIPE which is fine
+        posix_fadvise(fd,0,0,POSIX_FADV_SEQUENTIAL);
+#endif
+    };
+
+    //!
+    //! \brief advance past delimiters, reading more input as needed. false at end of input.
+    //!
+    bool skipDelimiters()
+    {
+        for (;;) {
+            while (first<last && isdel[static_cast<unsigned char>(buf[first])]) ++first;
+            if (first<last) return true;
+            if (at_eof) return false;
+            first = last = 0;
+            refill();
+        }
+    };
+
+    //!
+    //! \brief fill the free space at the end of the buffer
+    //!
+    void refill()
+    {
+        size_t room = cap-last;
+        ssize_t n;
+        if (is) {
+            is->read(buf+last,room);
+            n = is->gcount();
+            if (is->bad()) throw SystemError(string("StreamTokenizer error reading stream"));
+        }
+        else {
+            do {
+                errno = 0;
+                n = read(fd,buf+last,room);
+            } while (n==-1 && errno==EINTR);
+            if (n==-1) throw SystemError(string("StreamTokenizer error reading file"),errno);
+        }
+        if (n==0) at_eof = true;
+        last += n;
+        nread += n;
+    };
+};
+
+}
+#endif /* STREAMTOKENIZER_HPP_ */
@@ -0,0 +1,295 @@
+/*
+ * StringPool.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef STRINGPOOL_HPP_
+#define STRINGPOOL_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <iostream>
+#include "Allocators.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief a handle to a string held by a StringPool.
+//!
+//!  Equal strings interned in the same pool share one copy, so handles compare and hash by pointer.
+//!  The characters are null terminated and preceded by their length. A default constructed handle
+//!  is the empty string, which is the same handle in every pool.
+//!
+class InternedString {
+public:
+    InternedString() throw ():p(emptyData())
+    {
+    };
+
+    const char *c_str() const throw ()
+    {
+        return p;
+    };
+
+    const char *data() const throw ()
+    {
+        return p;
+    };
+
+    size_t size() const throw ()
+    {
+        return reinterpret_cast<const size_t*>(p)[-1];
+    };
+
+    bool empty() const throw ()
+    {
+        return size()==0;
+    };
+
+    string str() const
+    {
+        return string(p,size());
+    };
+
+    bool operator==(const InternedString& s) const throw ()
+    {
+        return p==s.p;
+    };
+
+    bool operator!=(const InternedString& s) const throw ()
+    {
+        return p!=s.p;
+    };
+
+    //!
+    //! \brief an arbitrary but fixed order, by address
+    //!
+    bool operator<(const InternedString& s) const throw ()
+    {
+        return p<s.p;
+    };
+
+private:
+    friend class StringPool;
+    const char *p;
+
+    explicit InternedString(const char *ptr) throw ():p(ptr)
+    {
+    };
+
+    static const char *emptyData() throw ()
+    {
+        static const size_t empty_entry[2] = { 0, 0 };
+        return reinterpret_cast<const char*>(empty_entry+1);
+    };
+};
+
+inline ostream& operator<<(ostream& os,const InternedString& s)
+{
+    return os.write(s.data(),s.size());
+}
+
+//!
+//! \brief hash of an InternedString, by address
+//!
+struct InternedStringHash {
+    size_t operator()(const InternedString& s) const throw ()
+    {
+        return hash<const void*>()(s.data());
+    };
+};
+
+//!
+//! \brief a set of strings each stored once, handed out as InternedString handles.
+//!
+//!  The pool is split into shards chosen by the hash of the string, each with its own lock, open
+//!  addressing table and Arena for the characters, so threads interning different strings seldom
+//!  wait on each other. Strings stay until the pool is destroyed. global() is a pool shared by the
+//!  whole program.
+//!
+class StringPool {
+public:
+    StringPool()
+    {
+    };
+
+    virtual ~StringPool()
+    {
+    };
+
+    //!
+    //! \brief the pool shared by the whole program
+    //!
+    static StringPool& global()
+    {
+        static StringPool pool;
+        return pool;
+    };
+
+    //!
+    //! \brief return the handle of the string [s,s+n), adding it to the pool if need be
+    //!
+    InternedString intern(const char *s,size_t n)
+    {
+        if (n==0) return InternedString();
+        size_t h = hashBytes(s,n);
+        Shard& shard = shards[h%NSHARDS];
+        lock_guard<mutex> lock(shard.mtx);
+        size_t slot;
+        if (shard.probe(h,s,n,slot)) return InternedString(shard.slots[slot].p);
+        char *mem = static_cast<char*>(shard.arena.allocate(sizeof(size_t)+n+1,sizeof(size_t)));
+        *reinterpret_cast<size_t*>(mem) = n;
+        char *p = mem+sizeof(size_t);
+        memcpy(p,s,n);
+        p[n] = 0;
+        shard.insert(slot,h,p);
+        return InternedString(p);
+    };
+
+    InternedString intern(const string& s)
+    {
+        return intern(s.data(),s.size());
+    };
+
+    //!
+    //! \brief look the string [s,s+n) up without adding it. Returns false if it was never interned.
+    //!
+    bool find(const char *s,size_t n,InternedString& out) const
+    {
+        if (n==0) {
+            out = InternedString();
+            return true;
+        }
+        size_t h = hashBytes(s,n);
+        Shard& shard = shards[h%NSHARDS];
+        lock_guard<mutex> lock(shard.mtx);
+        size_t slot;
+        if (!shard.probe(h,s,n,slot)) return false;
+        out = InternedString(shard.slots[slot].p);
+        return true;
+    };
+
+    bool find(const string& s,InternedString& out) const
+    {
+        return find(s.data(),s.size(),out);
+    };
+
+    //!
+    //! \brief the number of distinct strings held
+    //!
+    size_t size() const
+    {
+        size_t n = 0;
+        for (size_t k=0; k<NSHARDS; ++k) {
+            lock_guard<mutex> lock(shards[k].mtx);
+            n += shards[k].count;
+        }
+        return n;
+    };
+
+    //!
+    //! \brief the memory used by the pool, characters, lengths and tables included
+    //!
+    size_t bytesUsed() const
+    {
+        size_t n = 0;
+        for (size_t k=0; k<NSHARDS; ++k) {
+            lock_guard<mutex> lock(shards[k].mtx);
+            n += shards[k].arena.bytesUsed()+shards[k].slots.capacity()*sizeof(Slot);
+        }
+        return n;
+    };
+
+    //!
+    //! \brief FNV-1a hash of n bytes
+    //!
+    static size_t hashBytes(const char *s,size_t n) throw ()
+    {
+        unsigned long long h = 14695981039346656037ULL;
+        for (size_t k=0; k<n; ++k) {
+            h ^= static_cast<unsigned char>(s[k]);
+            h *= 1099511628211ULL;
+        }
+        return size_t(h ^ (h>>32));
+    };
+
+private:
+    StringPool(const StringPool&);
+    StringPool& operator=(const StringPool&);
+
+    enum { NSHARDS = 16 };
+
+    struct Slot {
+        size_t hash;
+        const char *p;
+    };
+
+    struct Shard {
+        mutable mutex mtx;
+        vector<Slot> slots;
+        size_t count;
+        Arena arena;
+
+        Shard():slots(),count(0),arena(64*1024) {};
+
+        //!
+        //! \brief find the slot holding [s,s+n) or, returning false, the free slot where it belongs
+        //!
+        bool probe(size_t h,const char *s,size_t n,size_t& slot) const
+        {
+            if (slots.empty()) {
+                slot = 0;
+                return false;
+            }
+            size_t mask = slots.size()-1;
+            for (size_t k=(h/NSHARDS)&mask;; k=(k+1)&mask) {
+                const Slot& e = slots[k];
+                if (!e.p) {
+                    slot = k;
+                    return false;
+                }
+                if (e.hash==h && reinterpret_cast<const size_t*>(e.p)[-1]==n && memcmp(e.p,s,n)==0) {
+                    slot = k;
+                    return true;
+                }
+            }
+        };
+
+        void insert(size_t slot,size_t h,const char *p)
+        {
+            if (2*(count+1)>slots.size()) {
+                grow();
+                size_t n = reinterpret_cast<const size_t*>(p)[-1];
+                probe(h,p,n,slot);
+            }
+            slots[slot].hash = h;
+            slots[slot].p = p;
+            ++count;
+        };
+
+        void grow()
+        {
+            vector<Slot> old;
+            old.swap(slots);
+            Slot empty_slot = { 0, 0 };
+            slots.assign((old.size()) ? 2*old.size():64,empty_slot);
+            size_t mask = slots.size()-1;
+            for (size_t j=0; j<old.size(); ++j) {
+                if (!old[j].p) continue;
+                size_t k = (old[j].hash/NSHARDS)&mask;
+                while (slots[k].p) k = (k+1)&mask;
+                slots[k] = old[j];
+            }
+        };
+    };
+
+    mutable Shard shards[NSHARDS];
+};
+
+}
+#endif /* STRINGPOOL_HPP_ */
@@ -0,0 +1,701 @@
+/*
+ * StructuredOptionReader.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef STRUCTUREDOPTIONREADER_HPP_
+#define STRUCTUREDOPTIONREADER_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include "putils.hpp"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief the callback given each flattened name and value
+//!
+typedef function<void(const string& key,const string& value)> option_sink_t;
+
+//!
+//! \brief return "line:column" (both counted from 1) of offset in data
+//!
+inline string textPosition(const char *data,size_t offset)
+{
+    size_t line = 1;
+    size_t line_start = 0;
+    const char *p = data;
+    const char *end = data+offset;
+    while (p<end) {
+        const char *nl = static_cast<const char*>(memchr(p,'\n',end-p));
+        if (!nl) break;
+        ++line;
+        line_start = (nl-data)+1;
+        p = nl+1;
+    }
+    return type2string(line)+":"+type2string(offset-line_start+1);
+}
+
+//!
+//! \brief append the UTF-8 encoding of the code point cp to out
+//!
+inline void appendUtf8(string& out,unsigned long cp)
+{
+    if (cp<0x80) {
+        out += char(cp);
+    }
+    else if (cp<0x800) {
+        out += char(0xC0|(cp>>6));
+        out += char(0x80|(cp&0x3F));
+    }
+    else if (cp<0x10000) {
+        out += char(0xE0|(cp>>12));
+        out += char(0x80|((cp>>6)&0x3F));
+        out += char(0x80|(cp&0x3F));
+    }
+    else {
+        out += char(0xF0|(cp>>18));
+        out += char(0x80|((cp>>12)&0x3F));
+        out += char(0x80|((cp>>6)&0x3F));
+        out += char(0x80|(cp&0x3F));
+    }
+}
+
+//!
+//! \brief reads a JSON document into flattened option names and values without building a tree.
+//!
+//!  The first pass classifies the input 64 bytes at a time (with SSE2 where available) into bit
+//!  masks of quotes, backslashes and the characters { } [ ] : , and from those produces the offsets
+//!  of every structural character outside strings, as simdjson does. The second pass walks that
+//!  index, so the bytes of strings and numbers are only looked at when they are copied out.
+//!
+//!  Members of nested objects are named by joining the names with '.', e.g. {"a":{"b":1}} gives
+//!  a.b = 1. An array of scalars gives one value joined with ',' and objects inside arrays are
+//!  named by their position, e.g. a.0.b. Booleans give true/false, numbers their text and null
+//!  gives no value. Errors throw a ParseError naming the line and column.
+//!
+class JsonOptionReader {
+public:
+    JsonOptionReader():data(0),len(0),next(0),depth(0)
+    {
+    };
+
+    virtual ~JsonOptionReader()
+    {
+    };
+
+    void parse(const char *data_in,size_t len_in,const option_sink_t& sink_in)
+    {
+        data = data_in;
+        len = len_in;
+        sink = sink_in;
+        next = 0;
+        depth = 0;
+        path.clear();
+        buildIndex();
+        size_t pos = skipSpace(0);
+        if (pos==len) return;
+        if (next>=index.size() || index[0]!=pos || data[pos]!='{') fail(pos,"expected a JSON object");
+        ++next;
+        parseObject();
+        pos = skipSpace(index[next-1]+1);
+        if (pos!=len) fail(pos,"unexpected text after the JSON object");
+    };
+
+private:
+    const char *data;
+    size_t len;
+    option_sink_t sink;
+    vector<uint32_t> index;
+    size_t next;
+    size_t depth;
+    string path;
+
+    enum { MAX_DEPTH = 1024 };
+
+    void fail(size_t pos,const char *msg) const
+    {
+        string err("JSON ");
+        err += textPosition(data,pos);
+        err += " ";
+        err += msg;
+        throw ParseError(err);
+    };
+
+    static bool isSpace(char ch) throw()
+    {
+        return ch==' ' || ch=='\n' || ch=='\t' || ch=='\r';
+    };
+
+    size_t skipSpace(size_t pos) const throw()
+    {
+        while (pos<len && isSpace(data[pos])) ++pos;
+        return pos;
+    };
+
+    //!
+    //! \brief classify the 64 bytes of block into masks of backslashes, quotes and { } [ ] : ,
+    //!
+    static void classify(const char *block,uint64_t& bs,uint64_t& quote,uint64_t& ops) throw()
+    {
+        bs = quote = ops = 0;
+#ifdef __SSE2__
+        const __m128i c_bs = _mm_set1_epi8('\\');
+        const __m128i c_quote = _mm_set1_epi8('"');
+        const __m128i c_colon = _mm_set1_epi8(':');
+        const __m128i c_comma = _mm_set1_epi8(',');
+        // setting bit 0x20 maps '[' to '{' and ']' to '}' and nothing else onto either
+        const __m128i c_case = _mm_set1_epi8(0x20);
+        const __m128i c_open = _mm_set1_epi8('{');
+        const __m128i c_close = _mm_set1_epi8('}');
+        for (int k=0; k<4; ++k) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block+16*k));
+            uint64_t b = uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v,c_bs)));
+            uint64_t q = uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v,c_quote)));
+            __m128i o = _mm_or_si128(_mm_cmpeq_epi8(v,c_colon),_mm_cmpeq_epi8(v,c_comma));
+            __m128i lv = _mm_or_si128(v,c_case);
+            o = _mm_or_si128(o,_mm_or_si128(_mm_cmpeq_epi8(lv,c_open),_mm_cmpeq_epi8(lv,c_close)));
+            uint64_t m = uint16_t(_mm_movemask_epi8(o));
+            bs |= b<<(16*k);
+            quote |= q<<(16*k);
+            ops |= m<<(16*k);
+        }
+#else
+        for (int k=0; k<64; ++k) {
+            char ch = block[k];
+            bs |= uint64_t(ch=='\\')<<k;
+            quote |= uint64_t(ch=='"')<<k;
+            ops |= uint64_t(ch=='{' || ch=='}' || ch=='[' || ch==']' || ch==':' || ch==',')<<k;
+        }
+#endif
+    };
+
+    //!
+    //! \brief bit k is set when bit k or an odd number of bits below it are set in x
+    //!
+    static uint64_t prefixXor(uint64_t x) throw()
+    {
+        x ^= x<<1;
+        x ^= x<<2;
+        x ^= x<<4;
+        x ^= x<<8;
+        x ^= x<<16;
+        x ^= x<<32;
+        return x;
+    };
+
+    //!
+    //! \brief first pass, record the offsets of the structural characters outside of strings and of every real quote
+    //!
+    void buildIndex()
+    {
+        index.clear();
+        index.reserve(len/8+16);
+        if (len>=0xFFFFFFFFUL) fail(0,"document too large");
+        uint64_t in_string = 0;
+        bool escape_carry = false;
+        char block[64];
+        for (size_t base=0; base<len; base+=64) {
+            const char *p = data+base;
+            if (base+64>len) {
+                memset(block,' ',sizeof(block));
+                memcpy(block,p,len-base);
+                p = block;
+            }
+            uint64_t bs;
+            uint64_t quote;
+            uint64_t ops;
+            classify(p,bs,quote,ops);
+            uint64_t escaped = (escape_carry) ? 1:0;
+            escape_carry = false;
+            // a backslash escapes the next character unless it is escaped itself
+            for (uint64_t b=bs; b; b&=b-1) {
+                int k = __builtin_ctzll(b);
+                if (escaped & (uint64_t(1)<<k)) continue;
+                if (k==63) escape_carry = true;
+                else escaped |= uint64_t(1)<<(k+1);
+            }
+            quote &= ~escaped;
+            uint64_t strings = prefixXor(quote) ^ in_string;
+            in_string = uint64_t(int64_t(strings)>>63);
+            uint64_t structural = (ops & ~strings) | quote;
+            while (structural) {
+                index.push_back(uint32_t(base+__builtin_ctzll(structural)));
+                structural &= structural-1;
+            }
+        }
+        if (in_string) fail(len,"unterminated string");
+    };
+
+    char peekStructural() const
+    {
+        if (next>=index.size()) fail(len,"unexpected end of document");
+        return data[index[next]];
+    };
+
+    //!
+    //! \brief check that only white space lies between the last structural and the next one
+    //!
+    void expectGap() const
+    {
+        size_t from = index[next-1]+1;
+        size_t pos = skipSpace(from);
+        if (next<index.size() && pos!=index[next]) fail(pos,"unexpected text");
+    };
+
+    //!
+    //! \brief append the string whose opening quote is the next structural to out, consuming both quotes
+    //!
+    void takeString(string& out)
+    {
+        size_t open = index[next];
+        if (next+1>=index.size()) fail(open,"unterminated string");
+        size_t close = index[next+1];
+        next += 2;
+        const char *p = data+open+1;
+        const char *end = data+close;
+        for (const char *c=p; c<end; ++c) {
+            if (static_cast<unsigned char>(*c)<0x20) fail(c-data,"control character in string");
+        }
+        const char *bs = static_cast<const char*>(memchr(p,'\\',end-p));
+        if (!bs) {
+            out.append(p,end);
+            return;
+        }
+        while (p<end) {
+            if (*p!='\\') {
+                const char *run = p;
+                while (p<end && *p!='\\') ++p;
+                out.append(run,p);
+                continue;
+            }
+            ++p;
+            switch (*p++) {
+            case '"':
+                out += '"';
+                break;
+            case '\\':
+                out += '\\';
+                break;
+            case '/':
+                out += '/';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u': {
+                unsigned long cp = hex4(p,end);
+                p += 4;
+                if (cp>=0xD800 && cp<0xDC00 && end-p>=6 && p[0]=='\\' && p[1]=='u') {
+                    unsigned long lo = hex4(p+2,end);
+                    if (lo>=0xDC00 && lo<0xE000) {
+                        cp = 0x10000 + ((cp-0xD800)<<10) + (lo-0xDC00);
+                        p += 6;
+                    }
+                }
+                appendUtf8(out,cp);
+                break;
+            }
+            default:
+                fail(p-1-data,"invalid escape in string");
+            }
+        }
+    };
+
+    unsigned long hex4(const char *p,const char *end) const
+    {
+        if (end-p<4) fail(p-data,"truncated \\u escape");
+        unsigned long v = 0;
+        for (int k=0; k<4; ++k) {
+            char ch = p[k];
+            v <<= 4;
+            if (ch>='0' && ch<='9') v |= ch-'0';
+            else if (ch>='a' && ch<='f') v |= ch-'a'+10;
+            else if (ch>='A' && ch<='F') v |= ch-'A'+10;
+            else fail(p+k-data,"invalid \\u escape");
+        }
+        return v;
+    };
+
+    //!
+    //! \brief append the scalar (number, true or false) between the last structural and the next one
+    //!  to out. Returns false for null.
+    //!
+    bool takeScalar(string& out)
+    {
+        size_t from = skipSpace(index[next-1]+1);
+        size_t to = (next<index.size()) ? index[next]:len;
+        while (to>from && isSpace(data[to-1])) --to;
+        if (to==from) fail(from,"expected a value");
+        const char *p = data+from;
+        size_t n = to-from;
+        if ((n==4 && memcmp(p,"true",4)==0) || (n==5 && memcmp(p,"false",5)==0)) {
+            out.append(p,n);
+            return true;
+        }
+        if (n==4 && memcmp(p,"null",4)==0) return false;
+        if (p[0]!='-' && !isDigit(p[0])) fail(from,"invalid value");
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?, failing at the first byte which breaks it
+        size_t k = (p[0]=='-') ? 1:0;
+        if (k<n && p[k]=='0') ++k;
+        else if (k<n && isDigit(p[k])) {
+            while (k<n && isDigit(p[k])) ++k;
+        }
+        else fail(from+k,"invalid number");
+        if (k<n && p[k]=='.') {
+            ++k;
+            if (!(k<n && isDigit(p[k]))) fail(from+k,"invalid number");
+            while (k<n && isDigit(p[k])) ++k;
+        }
+        if (k<n && (p[k]=='e' || p[k]=='E')) {
+            ++k;
+            if (k<n && (p[k]=='+' || p[k]=='-')) ++k;
+            if (!(k<n && isDigit(p[k]))) fail(from+k,"invalid number");
+            while (k<n && isDigit(p[k])) ++k;
+        }
+        if (k!=n) fail(from+k,"invalid number");
+        out.append(p,n);
+        return true;
+    };
+
+    static bool isDigit(char ch) throw()
+    {
+        return ch>='0' && ch<='9';
+    };
+
+    //!
+    //! \brief parse the value starting after the last structural, named by path. A scalar is
+    //!  appended to out and true returned, objects and arrays are emitted as they are read.
+    //!  Afterwards only white space lies before the next structural.
+    //!
+    bool parseValue(string& out)
+    {
+        size_t pos = skipSpace(index[next-1]+1);
+        if (next<index.size() && pos==index[next]) {
+            char ch = data[pos];
+            bool has_scalar = false;
+            if (ch=='{') {
+                ++next;
+                parseObject();
+            }
+            else if (ch=='[') {
+                ++next;
+                parseArray();
+            }
+            else if (ch=='"') {
+                takeString(out);
+                has_scalar = true;
+            }
+            else {
+                fail(pos,"expected a value");
+            }
+            expectGap();
+            return has_scalar;
+        }
+        return takeScalar(out);
+    };
+
+    void parseObject()
+    {
+        if (++depth>MAX_DEPTH) fail(index[next-1],"nesting too deep");
+        expectGap();
+        if (peekStructural()=='}') {
+            ++next;
+            --depth;
+            return;
+        }
+        size_t base = path.size();
+        string value;
+        for (;;) {
+            if (peekStructural()!='"') fail(index[next],"expected a member name");
+            if (base) path += '.';
+            takeString(path);
+            expectGap();
+            if (peekStructural()!=':') fail(index[next],"expected ':'");
+            ++next;
+            value.clear();
+            if (parseValue(value)) sink(path,value);
+            path.resize(base);
+            char ch = peekStructural();
+            ++next;
+            if (ch=='}') break;
+            if (ch!=',') fail(index[next-1],"expected ',' or '}'");
+            expectGap();
+        }
+        --depth;
+    };
+
+    void parseArray()
+    {
+        if (++depth>MAX_DEPTH) fail(index[next-1],"nesting too deep");
+        size_t pos = skipSpace(index[next-1]+1);
+        if (next<index.size() && pos==index[next] && data[pos]==']') {
+            ++next;
+            --depth;
+            return;
+        }
+        size_t base = path.size();
+        string joined;
+        bool any = false;
+        for (size_t element=0;; ++element) {
+            if (base) path += '.';
+            path += type2string(element);
+            size_t before = joined.size();
+            if (any) joined += ',';
+            if (parseValue(joined)) any = true;
+            else joined.resize(before);
+            path.resize(base);
+            char ch = peekStructural();
+            ++next;
+            if (ch==']') break;
+            if (ch!=',') fail(index[next-1],"expected ',' or ']'");
+        }
+        if (any) sink(path,joined);
+        --depth;
+    };
+};
+
+//!
+//! \brief reads the commonly used subset of TOML into flattened option names and values.
+//!
+//!  Supported are key = value lines with bare, quoted or dotted keys, [table] and [a.b] headers,
+//!  basic strings with escapes, literal strings, integers, floats, booleans, date/time words and
+//!  single line arrays of scalars, which give one value joined with ','. Comments start with #.
+//!  Multi-line strings, inline tables and arrays of tables are reported as errors. TOML is line
+//!  oriented, so the input is scanned line by line with memchr rather than with a structural index.
+//!
+class TomlOptionReader {
+public:
+    TomlOptionReader():data(0),len(0)
+    {
+    };
+
+    virtual ~TomlOptionReader()
+    {
+    };
+
+    void parse(const char *data_in,size_t len_in,const option_sink_t& sink)
+    {
+        data = data_in;
+        len = len_in;
+        string table;
+        const char *p = data;
+        const char *end = data+len;
+        while (p<end) {
+            const char *eol = static_cast<const char*>(memchr(p,'\n',end-p));
+            if (!eol) eol = end;
+            const char *q = skipBlank(p,eol);
+            const char *line_end = eol;
+            p = eol+1;
+            if (q==line_end || *q=='#') continue;
+            if (*q=='[') {
+                if (q+1<line_end && q[1]=='[') fail(q,"arrays of tables are not supported");
+                ++q;
+                table = parseKey(q,line_end);
+                q = skipBlank(q,line_end);
+                if (q==line_end || *q!=']') fail(q,"expected ']'");
+                expectEnd(q+1,line_end);
+                continue;
+            }
+            string key = parseKey(q,line_end);
+            if (table.size()) key = table+"."+key;
+            q = skipBlank(q,line_end);
+            if (q==line_end || *q!='=') fail(q,"expected '='");
+            q = skipBlank(q+1,line_end);
+            string value;
+            if (q<line_end && *q=='[') {
+                ++q;
+                bool any = false;
+                for (;;) {
+                    q = skipBlank(q,line_end);
+                    if (q<line_end && *q==']') {
+                        ++q;
+                        break;
+                    }
+                    if (any) value += ',';
+                    value += parseScalar(q,line_end);
+                    any = true;
+                    q = skipBlank(q,line_end);
+                    if (q<line_end && *q==',') {
+                        ++q;
+                        continue;
+                    }
+                    if (q<line_end && *q==']') {
+                        ++q;
+                        break;
+                    }
+                    fail(q,"expected ',' or ']'");
+                }
+            }
+            else {
+                value = parseScalar(q,line_end);
+            }
+            expectEnd(q,line_end);
+            sink(key,value);
+        }
+    };
+
+private:
+    const char *data;
+    size_t len;
+
+    void fail(const char *at,const char *msg) const
+    {
+        string err("TOML ");
+        err += textPosition(data,at-data);
+        err += " ";
+        err += msg;
+        throw ParseError(err);
+    };
+
+    static const char *skipBlank(const char *p,const char *end) throw()
+    {
+        while (p<end && (*p==' ' || *p=='\t' || *p=='\r')) ++p;
+        return p;
+    };
+
+    void expectEnd(const char *p,const char *end) const
+    {
+        p = skipBlank(p,end);
+        if (p<end && *p!='#') fail(p,"unexpected text after value");
+    };
+
+    static bool isBare(char ch) throw()
+    {
+        return (ch>='a' && ch<='z') || (ch>='A' && ch<='Z') || (ch>='0' && ch<='9') || ch=='_' || ch=='-';
+    };
+
+    //!
+    //! \brief parse a possibly dotted and quoted key, joining the parts with '.'
+    //!
+    string parseKey(const char *& p,const char *end) const
+    {
+        string key;
+        for (;;) {
+            p = skipBlank(p,end);
+            if (p<end && (*p=='"' || *p=='\'')) {
+                key += parseString(p,end);
+            }
+            else {
+                const char *k = p;
+                while (p<end && isBare(*p)) ++p;
+                if (p==k) fail(p,"expected a key");
+                key.append(k,p);
+            }
+            p = skipBlank(p,end);
+            if (p<end && *p=='.') {
+                key += '.';
+                ++p;
+                continue;
+            }
+            return key;
+        }
+    };
+
+    string parseString(const char *& p,const char *end) const
+    {
+        char quote = *p++;
+        if (end-p>=2 && p[0]==quote && p[1]==quote) fail(p-1,"multi-line strings are not supported");
+        string out;
+        while (p<end && *p!=quote) {
+            if (quote=='"' && *p=='\\') {
+                ++p;
+                if (p==end) break;
+                switch (*p++) {
+                case '"':
+                    out += '"';
+                    break;
+                case '\\':
+                    out += '\\';
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u':
+                case 'U': {
+                    int n = (p[-1]=='u') ? 4:8;
+                    if (end-p<n) fail(p,"truncated unicode escape");
+                    unsigned long cp = 0;
+                    for (int k=0; k<n; ++k) {
+                        char ch = p[k];
+                        cp <<= 4;
+                        if (ch>='0' && ch<='9') cp |= ch-'0';
+                        else if (ch>='a' && ch<='f') cp |= ch-'a'+10;
+                        else if (ch>='A' && ch<='F') cp |= ch-'A'+10;
+                        else fail(p+k,"invalid unicode escape");
+                    }
+                    p += n;
+                    appendUtf8(out,cp);
+                    break;
+                }
+                default:
+                    fail(p-1,"invalid escape in string");
+                }
+                continue;
+            }
+            out += *p++;
+        }
+        if (p==end) fail(p,"unterminated string");
+        ++p;
+        return out;
+    };
+
+    string parseScalar(const char *& p,const char *end) const
+    {
+        if (p<end && (*p=='"' || *p=='\'')) return parseString(p,end);
+        if (p<end && *p=='{') fail(p,"inline tables are not supported");
+        const char *v = p;
+        while (p<end && *p!=',' && *p!=']' && *p!='#' && *p!=' ' && *p!='\t' && *p!='\r') ++p;
+        // date-times may hold one space between date and time
+        if (p+1<end && *p==' ' && p-v==10 && p[1]>='0' && p[1]<='9') {
+            ++p;
+            while (p<end && *p!=',' && *p!=']' && *p!='#' && *p!=' ' && *p!='\t' && *p!='\r') ++p;
+        }
+        if (p==v) fail(v,"expected a value");
+        string value(v,p);
+        // drop the digit separators TOML allows in numbers
+        if ((value[0]>='0' && value[0]<='9') || value[0]=='+' || value[0]=='-') {
+            string digits;
+            for (size_t k=0; k<value.size(); ++k) {
+                if (value[k]!='_') digits += value[k];
+            }
+            value.swap(digits);
+        }
+        return value;
+    };
+};
+
+}
+#endif /* STRUCTUREDOPTIONREADER_HPP_ */
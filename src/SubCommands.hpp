@@ -0,0 +1,220 @@
+/*
+ * SubCommands.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SUBCOMMANDS_HPP_
+#define SUBCOMMANDS_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <vector>
+#include "ProgramOptions.hpp"
+#include "ArgumentReader.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief one sub-command of a multi-tool program: its name, a one line description, the function
+//!  adding its options and the function running it with the global options and its own
+//!
+struct SubCommand {
+    const char *name;
+    const char *description;
+    void (*addOptions)(ProgramOptions& options);
+    int (*run)(ProgramOptions& global_options,ProgramOptions& options);
+};
+
+//!
+//! \brief runs the sub-command named on the command line, git style: prog [global options] command
+//!  [command options].
+//!
+//!  The commands are a static table sorted by name, so finding one is a binary search and only the
+//!  chosen command adds its options; the options of the others are never built. Global options
+//!  come before the command name. A global option given as -name value takes the next word as its
+//!  value unless that word names a command, so a value which is also a command name must be given
+//!  as -name=value. "prog help command" prints the options of command.
+//!
+//!  When the global options expand response files (see ProgramOptions::setResponseFiles) so do
+//!  the command's, and the command is looked for after expanding them, e.g. prog @global.rsp cmd.
+//!  Only the words before the command are copied, unless the command itself comes from a response
+//!  file.
+//!
+class CommandDispatcher {
+public:
+    CommandDispatcher(const SubCommand *commands_in,size_t ncommands_in):commands(commands_in),ncommands(ncommands_in)
+    {
+#ifndef NDEBUG
+        for (size_t k=1; k<ncommands; ++k) {
+            if (strcmp(commands[k-1].name,commands[k].name)>=0) {
+                cerr << "CommandDispatcher commands are not sorted by name at " << commands[k].name << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+#endif
+    };
+
+    template<size_t N>
+    CommandDispatcher(const SubCommand (&commands_in)[N]):CommandDispatcher(commands_in,N)
+    {
+    };
+
+    virtual ~CommandDispatcher()
+    {
+    };
+
+    //!
+    //! \brief the command called name or null
+    //!
+    const SubCommand *find(const char *name) const throw ()
+    {
+        size_t lo = 0;
+        size_t hi = ncommands;
+        while (lo<hi) {
+            size_t mid = (lo+hi)/2;
+            int c = strcmp(commands[mid].name,name);
+            if (c==0) return commands+mid;
+            if (c<0) lo = mid+1;
+            else hi = mid;
+        }
+        return 0;
+    };
+
+    //!
+    //! \brief parse the global options, build and parse the options of the command named on the
+    //!  command line and run it. Returns what the command returns.
+    //!
+    int run(int argc,char **argv,ProgramOptions& global_options)
+    {
+        bool expand = global_options.responseFiles();
+        ArgumentReader args(argc,argv,1,expand);
+        // the words before the command, expanded from any response files, with argv[0] first
+        vector<string> global_words(1,string(argv[0]));
+        string name;
+        bool found = false;
+        try {
+            const char *arg;
+            size_t len;
+            while (args.next(arg,len)) {
+                if (len==0 || arg[0]!='-') {
+                    name.assign(arg,len);
+                    found = true;
+                    break;
+                }
+                global_words.push_back(string(arg,len));
+                const char *next;
+                size_t nlen;
+                if (memchr(arg,'=',len) || !args.peek(next,nlen) || nlen==0 || next[0]=='-') continue;
+                if (isCommand(string(next,nlen).c_str())) continue;
+                // the word after a known global option is its value, as parseCommandLine takes it
+                size_t s = (len>1 && arg[1]=='-') ? 2:1;
+                if (global_options.hasOption(string(arg+s,len-s))) {
+                    args.next(next,nlen);
+                    global_words.push_back(string(next,nlen));
+                }
+            }
+        }
+        catch (exception& e) {
+            cerr << "CommandDispatcher::run exception " << e.what() << endl;
+            printUsage(global_options);
+        }
+        if (!found) {
+            cerr << "no command given\n";
+            printUsage(global_options);
+        }
+        // the command's words stay in argv unless the command came from a response file
+        vector<string> command_words;
+        int kfirst = argc;
+        bool in_argv = args.position(kfirst);
+        if (!in_argv) {
+            try {
+                const char *arg;
+                size_t len;
+                while (args.next(arg,len)) command_words.push_back(string(arg,len));
+            }
+            catch (exception& e) {
+                cerr << "CommandDispatcher::run exception " << e.what() << endl;
+                printUsage(global_options);
+            }
+        }
+        bool help = false;
+        if (name=="help" && !find(name.c_str())) {
+            if (in_argv) {
+                if (kfirst==argc) printUsage(global_options);
+                name = argv[kfirst++];
+            }
+            else {
+                if (command_words.empty()) printUsage(global_options);
+                name = command_words[0];
+                command_words.erase(command_words.begin());
+            }
+            help = true;
+        }
+        const SubCommand *cmd = find(name.c_str());
+        if (!cmd) {
+            cerr << "unknown command " << name << "\n";
+            printUsage(global_options);
+        }
+        ProgramOptions options;
+        cmd->addOptions(options);
+        if (help) {
+            cerr << cmd->name << " - " << cmd->description << "\n";
+            options.printHelp();
+        }
+        // the global words are expanded already
+        global_options.setResponseFiles(false);
+        vector<char*> global_argv = pointers(global_words);
+        global_options.parseCommandLine(int(global_argv.size()),global_argv.data());
+        global_options.setResponseFiles(expand);
+        if (in_argv) {
+            options.setResponseFiles(expand);
+            // argv[kfirst-1] is the command name, which parseCommandLine skips as a program name
+            options.parseCommandLine(argc-kfirst+1,argv+kfirst-1);
+        }
+        else {
+            command_words.insert(command_words.begin(),name);
+            vector<char*> command_argv = pointers(command_words);
+            options.parseCommandLine(int(command_argv.size()),command_argv.data());
+            options.setResponseFiles(expand);
+        }
+        return cmd->run(global_options,options);
+    };
+
+    //!
+    //! \brief print the global options and the list of commands then exit
+    //!
+    void printUsage(const ProgramOptions& global_options) const
+    {
+        cerr << "Commands are:\n";
+        for (size_t k=0; k<ncommands; ++k) {
+            cerr << "  " << commands[k].name << " - " << commands[k].description << "\n";
+        }
+        cerr << "Global options:\n";
+        global_options.printHelp();
+    };
+
+private:
+    //!
+    //! \brief the words as an argv for parseCommandLine
+    //!
+    static vector<char*> pointers(vector<string>& words)
+    {
+        vector<char*> p(words.size());
+        for (size_t k=0; k<words.size(); ++k) p[k] = &words[k][0];
+        return p;
+    };
+
+    bool isCommand(const char *name) const throw ()
+    {
+        return find(name) || strcmp(name,"help")==0;
+    };
+
+    const SubCommand *commands;
+    size_t ncommands;
+};
+
+}
+#endif /* SUBCOMMANDS_HPP_ */
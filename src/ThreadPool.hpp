@@ -0,0 +1,120 @@
+/*
+ * ThreadPool.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief a fixed set of worker threads running submitted tasks in submission order.
+//!
+//!  wait() blocks until every task submitted so far has finished and rethrows the first exception
+//!  thrown by any of them. The destructor finishes the queued tasks before joining the workers.
+//!
+class ThreadPool {
+public:
+    //!
+    //! \brief start nthreads workers, zero means one per hardware thread
+    //!
+    ThreadPool(size_t nthreads=0):outstanding(0),stopping(false)
+    {
+        if (nthreads==0) nthreads = thread::hardware_concurrency();
+        if (nthreads==0) nthreads = 1;
+        for (size_t k=0; k<nthreads; ++k) workers.push_back(thread(&ThreadPool::run,this));
+    };
+
+    virtual ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        task_cv.notify_all();
+        for (size_t k=0; k<workers.size(); ++k) workers[k].join();
+    };
+
+    //!
+    //! \brief queue a task to run on one of the workers
+    //!
+    void submit(const function<void()>& task)
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            tasks.push_back(task);
+            ++outstanding;
+        }
+        task_cv.notify_one();
+    };
+
+    //!
+    //! \brief wait for every submitted task to finish
+    //!
+    void wait()
+    {
+        unique_lock<mutex> lock(mtx);
+        while (outstanding) done_cv.wait(lock);
+        if (error) {
+            exception_ptr e = error;
+            error = exception_ptr();
+            rethrow_exception(e);
+        }
+    };
+
+    size_t size() const throw()
+    {
+        return workers.size();
+    };
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    vector<thread> workers;
+    deque< function<void()> > tasks;
+    size_t outstanding;
+    bool stopping;
+    exception_ptr error;
+    mutex mtx;
+    condition_variable task_cv;
+    condition_variable done_cv;
+
+    void run()
+    {
+        for (;;) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(mtx);
+                while (tasks.empty() && !stopping) task_cv.wait(lock);
+                if (tasks.empty()) return;
+                task.swap(tasks.front());
+                tasks.pop_front();
+            }
+            exception_ptr e;
+            try {
+                task();
+            }
+            catch (...) {
+                e = current_exception();
+            }
+            lock_guard<mutex> lock(mtx);
+            if (e && !error) error = e;
+            if (--outstanding==0) done_cv.notify_all();
+        }
+    };
+};
+
+}
+#endif /* THREADPOOL_HPP_ */
@@ -0,0 +1,328 @@
+/*
+ * Trace.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "OptionWriter.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+using namespace std;
+
+//!
+//!  Scoped trace regions. PUTILS_TRACE_SCOPE("name") records the time spent until the end of the
+//!  enclosing block as one event in a ring buffer owned by the calling thread, so recording takes
+//!  no lock. writeChromeTrace writes the events of every thread as Chrome trace JSON, which
+//!  chrome://tracing and Perfetto read. Regions nest as blocks do.
+//!
+//!  Without PUTILS_TRACE defined the macros expand to nothing. With it, tracing is off until
+//!  setTracing(true) and an idle region costs one test of a flag. Inline functions in headers must
+//!  use a TraceScope rather than the macro, since translation units built with and without
+//!  PUTILS_TRACE would otherwise see different definitions of them.
+//!
+#ifdef PUTILS_TRACE
+#define PUTILS_TRACE_CONCAT2(a,b) a##b
+#define PUTILS_TRACE_CONCAT(a,b) PUTILS_TRACE_CONCAT2(a,b)
+#define PUTILS_TRACE_SCOPE(name) putils::TraceScope PUTILS_TRACE_CONCAT(putils_trace_scope_,__LINE__)(name)
+#else
+#define PUTILS_TRACE_SCOPE(name)
+#endif
+
+namespace putils {
+
+//!
+//! \brief the fastest clock available, the time stamp counter where there is one, otherwise
+//!  CLOCK_MONOTONIC in nanoseconds. Ticks are converted to time when the trace is written.
+//!
+inline unsigned long long traceClock() throw ()
+{
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1000000000ULL+ts.tv_nsec;
+#endif
+}
+
+inline unsigned long long monotonicNanoseconds() throw ()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+//!
+//! \brief one completed region
+//!
+struct TraceEvent {
+    const char *name;
+    unsigned long long start;
+    unsigned long long end;
+    long tid;
+};
+
+//!
+//! \brief the events of one thread, the newest capacity of them kept.
+//!
+//!  Only the owning thread writes the events and the count. The count is published after each
+//!  event is stored, so a reader sees complete events, though events overwritten while it reads may
+//!  be mixed up; write the trace once the traced work is done. Clearing only records the count
+//!  in cleared, so it cannot lose an event being recorded. A buffer passes to a new thread once
+//!  its owner has ended, so each event keeps the thread it came from.
+//!
+class TraceBuffer {
+public:
+    TraceBuffer(size_t capacity_in,long tid_in):events(capacity_in),mask(capacity_in-1),count(0),cleared(0),tid(tid_in)
+    {
+    };
+
+    void record(const char *name,unsigned long long start,unsigned long long end) throw ()
+    {
+        unsigned long long n = count.load(memory_order_relaxed);
+        TraceEvent& e = events[n&mask];
+        e.name = name;
+        e.start = start;
+        e.end = end;
+        e.tid = tid;
+        count.store(n+1,memory_order_release);
+    };
+
+    vector<TraceEvent> events;
+    size_t mask;
+    atomic<unsigned long long> count;
+    atomic<unsigned long long> cleared;
+    long tid;
+};
+
+//!
+//! \brief the buffer of a thread, null before its first event and once it has ended
+//!
+struct TraceThreadState {
+    TraceBuffer *buffer;
+    bool ended;
+};
+
+//!
+//! \brief the state shared by every thread: the switch, the buffers and the clock calibration.
+//!
+//!  A buffer outlives its thread so that its events can still be written out, and is then given to
+//!  the next thread needing one, so there are only as many buffers as threads tracing at once.
+//!
+struct TraceRegistry {
+    atomic<bool> enabled;
+    mutex mtx;
+    vector<TraceBuffer*> buffers;
+    vector<TraceBuffer*> unowned;
+    size_t capacity;
+    unsigned long long tick0;
+    unsigned long long ns0;
+
+    TraceRegistry():enabled(false),mtx(),buffers(),unowned(),capacity(1<<15),tick0(traceClock()),ns0(monotonicNanoseconds())
+    {
+    };
+
+    ~TraceRegistry()
+    {
+        enabled.store(false,memory_order_relaxed);
+        for (size_t k=0; k<buffers.size(); ++k) delete buffers[k];
+    };
+
+    static TraceRegistry& instance()
+    {
+        static TraceRegistry registry;
+        return registry;
+    };
+
+    static TraceThreadState& threadState() throw ()
+    {
+        static __thread TraceThreadState state = { 0, false };
+        return state;
+    };
+
+    //!
+    //! \brief the buffer of the calling thread, taken on its first event. Null while the thread
+    //!  is ending, as its buffer may already be another thread's.
+    //!
+    static TraceBuffer *threadBuffer()
+    {
+        TraceThreadState& state = threadState();
+        if (!state.buffer && !state.ended) state.buffer = instance().adopt();
+        return state.buffer;
+    };
+
+private:
+    //!
+    //! \brief gives the thread's buffer back to the registry when the thread ends
+    //!
+    struct owner_t {
+        ~owner_t()
+        {
+            TraceThreadState& state = threadState();
+            state.ended = true;
+            if (!state.buffer) return;
+            TraceRegistry& r = instance();
+            lock_guard<mutex> lock(r.mtx);
+            r.unowned.push_back(state.buffer);
+            state.buffer = 0;
+        };
+    };
+
+    TraceBuffer *adopt()
+    {
+        static thread_local owner_t owner;
+        (void)owner;
+        lock_guard<mutex> lock(mtx);
+        long tid = syscall(SYS_gettid);
+        if (unowned.size()) {
+            TraceBuffer *buffer = unowned.back();
+            unowned.pop_back();
+            buffer->tid = tid;
+            return buffer;
+        }
+        TraceBuffer *buffer = new TraceBuffer(capacity,tid);
+        buffers.push_back(buffer);
+        return buffer;
+    };
+};
+
+//!
+//! \brief turn recording on or off at run time
+//!
+inline void setTracing(bool flag)
+{
+    TraceRegistry::instance().enabled.store(flag,memory_order_relaxed);
+}
+
+inline bool tracingEnabled() throw ()
+{
+    return TraceRegistry::instance().enabled.load(memory_order_relaxed);
+}
+
+//!
+//! \brief the number of events each thread keeps, rounded up to a power of two. Buffers already
+//!  made, which threads starting later may be given, keep their size.
+//!
+inline void setTraceCapacity(size_t nevents)
+{
+    size_t n = 1;
+    while (n<nevents) n <<= 1;
+    TraceRegistry& r = TraceRegistry::instance();
+    lock_guard<mutex> lock(r.mtx);
+    r.capacity = n;
+}
+
+//!
+//! \brief records the time from construction to destruction as a region called name, which must
+//!  outlive the trace (normally a string literal)
+//!
+class TraceScope {
+public:
+    explicit TraceScope(const char *name_in) throw ():name(name_in),start(0)
+    {
+        if (tracingEnabled()) start = traceClock();
+    };
+
+    ~TraceScope()
+    {
+        if (!start) return;
+        TraceBuffer *buffer = TraceRegistry::threadBuffer();
+        if (buffer) buffer->record(name,start,traceClock());
+    };
+
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    const char *name;
+    unsigned long long start;
+};
+
+//!
+//! \brief forget every recorded event
+//!
+inline void clearTrace()
+{
+    TraceRegistry& r = TraceRegistry::instance();
+    lock_guard<mutex> lock(r.mtx);
+    for (size_t k=0; k<r.buffers.size(); ++k) {
+        TraceBuffer& buf = *r.buffers[k];
+        buf.cleared.store(buf.count.load(memory_order_acquire),memory_order_relaxed);
+    }
+}
+
+//!
+//! \brief append the recorded events of every thread to out as Chrome trace JSON, with times in
+//!  microseconds since the first use of the trace
+//!
+inline void writeChromeTrace(OutputBuffer& out)
+{
+    TraceRegistry& r = TraceRegistry::instance();
+    double ns_per_tick = 1.;
+#ifdef HAVE_RDTSC
+    // calibrate the counter against the monotonic clock over the life of the trace
+    unsigned long long ns1 = monotonicNanoseconds();
+    if (ns1-r.ns0<10000000ULL) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        ns1 = monotonicNanoseconds();
+    }
+    unsigned long long tick1 = traceClock();
+    if (tick1>r.tick0) ns_per_tick = double(ns1-r.ns0)/double(tick1-r.tick0);
+#endif
+    long pid = getpid();
+    char num[64];
+    out.append("{\"traceEvents\":[",16);
+    bool first = true;
+    lock_guard<mutex> lock(r.mtx);
+    for (size_t b=0; b<r.buffers.size(); ++b) {
+        TraceBuffer& buf = *r.buffers[b];
+        unsigned long long n = buf.count.load(memory_order_acquire);
+        unsigned long long from = buf.cleared.load(memory_order_relaxed);
+        if (n-from>buf.events.size()) from = n-buf.events.size();
+        for (unsigned long long j=from; j<n; ++j) {
+            const TraceEvent& e = buf.events[j&buf.mask];
+            double ts = 1.e-3*ns_per_tick*double(e.start-r.tick0);
+            double dur = 1.e-3*ns_per_tick*double(e.end-e.start);
+            out.append((first) ? "\n":",\n",(first) ? 1:2);
+            first = false;
+            out.append("{\"name\":",8);
+            appendJsonString(out,e.name);
+            int len = snprintf(num,sizeof(num),",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",ts,dur);
+            out.append(num,len);
+            out.append(",\"pid\":",7);
+            out.appendUnsigned(pid);
+            out.append(",\"tid\":",7);
+            out.appendUnsigned(e.tid);
+            out.append('}');
+        }
+    }
+    out.append("\n]}\n",4);
+}
+
+//!
+//! \brief write the trace to the file filename (see writeChromeTrace(OutputBuffer&))
+//!
+inline void writeChromeTrace(const string& filename)
+{
+    OutputBuffer out(1<<20);
+    writeChromeTrace(out);
+    out.writeTo(filename);
+}
+
+}
+#endif /* TRACE_HPP_ */
@@ -0,0 +1,204 @@
+/*
+ * TunableControl.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef TUNABLECONTROL_HPP_
+#define TUNABLECONTROL_HPP_
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <mutex>
+#include <unistd.h>
+#include "putils.hpp"
+#include "OptionWriter.hpp"
+#include "ProgramOptions.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief changes the options of a running program, and so the Tunables bound to them.
+//!
+//!  Values set through the control form a source of their own, named "control" by default, which
+//!  is added when the control is made; make the control before parsing the other sources for its
+//!  values to take precedence over theirs. Setting an option which a source before the control
+//!  gives is refused, since the value would not be used. An option file parsed earlier can be
+//!  reloaded, which changes only the options whose values differ.
+//!
+//!  The control serializes its own changes, and a Tunable may be read from any thread while they
+//!  happen, but the ProgramOptions itself is not locked: no other thread should use it meanwhile.
+//!
+class TunableControl {
+public:
+    explicit TunableControl(ProgramOptions& options_in,const string& source_name="control"):
+        options(options_in),source(source_name)
+    {
+        options.addSource(source);
+    };
+
+    virtual ~TunableControl()
+    {
+    };
+
+    //!
+    //! \brief give option_name the value value. Throws ParseError, leaving the option as it was, if
+    //!  there is no such option, a Tunable bound to it cannot take the value or a source before the
+    //!  control gives the option.
+    //!
+    void set(const string& option_name,const string& value)
+    {
+        lock_guard<mutex> lock(mtx);
+        if (!options.hasOption(option_name)) throw ParseError(string("no option named ")+option_name);
+        string previous;
+        bool had_value = options.getSourceValue(source,option_name,previous);
+        try {
+            options.setSourceValue(source,option_name,value);
+        }
+        catch (exception& e) {
+            throw ParseError(string("bad value ")+value+" for "+option_name+": "+e.what());
+        }
+        string from = options.sourceOf(option_name);
+        if (from!=source) {
+            // the value is hidden by an earlier source, do not keep it
+            if (had_value) options.setSourceValue(source,option_name,previous);
+            else options.unsetSourceValue(source,option_name);
+            throw ParseError(option_name+" is given by "+from+", which takes precedence over "+source);
+        }
+    };
+
+    //!
+    //! \brief drop the value set for option_name, which returns to the one the other sources give.
+    //!  Throws ParseError if there is no such option.
+    //!
+    void reset(const string& option_name)
+    {
+        lock_guard<mutex> lock(mtx);
+        if (!options.hasOption(option_name)) throw ParseError(string("no option named ")+option_name);
+        options.unsetSourceValue(source,option_name);
+    };
+
+    //!
+    //! \brief the value of option_name. Throws ParseError if there is no such option.
+    //!
+    string get(const string& option_name)
+    {
+        lock_guard<mutex> lock(mtx);
+        if (!options.hasOption(option_name)) throw ParseError(string("no option named ")+option_name);
+        return options.getValue(option_name);
+    };
+
+    //!
+    //! \brief parse the option file filename again (see ProgramOptions::loadOptionFile). Errors
+    //!  throw, leaving the options as they were, rather than ending the program.
+    //!
+    void reload(const string& filename)
+    {
+        lock_guard<mutex> lock(mtx);
+        options.loadOptionFile(filename);
+    };
+
+    //!
+    //! \brief run the commands read from in_fd, one per line, until end of file, writing a reply
+    //!  line for each to out_fd, e.g. over a pipe or a connected socket.
+    //!
+    //!  The commands are "set name value", "get name", "reset name" and "reload file". The value is
+    //!  the rest of the line. The reply is "ok", "name = value" for get, or "error" and the reason.
+    //!
+    void serve(int in_fd,int out_fd)
+    {
+        string pending;
+        char buf[4096];
+        OutputBuffer out(256);
+        for (;;) {
+            ssize_t n = ::read(in_fd,buf,sizeof(buf));
+            if (n<0 && errno==EINTR) continue;
+            if (n<0) throw SystemError(string("TunableControl cannot read commands"),errno);
+            if (n==0) break;
+            pending.append(buf,n);
+            size_t start = 0;
+            size_t eol;
+            while ((eol = pending.find('\n',start))!=string::npos) {
+                runCommand(pending.substr(start,eol-start),out);
+                start = eol+1;
+            }
+            pending.erase(0,start);
+            out.writeTo(out_fd);
+            out.clear();
+        }
+        if (pending.size()) {
+            runCommand(pending,out);
+            out.writeTo(out_fd);
+        }
+    };
+
+private:
+    TunableControl(const TunableControl&);
+    TunableControl& operator=(const TunableControl&);
+
+    ProgramOptions& options;
+    string source;
+    mutex mtx;
+
+    static bool isBlank(char ch) throw ()
+    {
+        return ch==' ' || ch=='\t' || ch=='\r';
+    };
+
+    //!
+    //! \brief split the next blank separated word from line starting at pos
+    //!
+    static string nextWord(const string& line,size_t& pos)
+    {
+        while (pos<line.size() && isBlank(line[pos])) ++pos;
+        size_t start = pos;
+        while (pos<line.size() && !isBlank(line[pos])) ++pos;
+        return line.substr(start,pos-start);
+    };
+
+    void runCommand(const string& line,OutputBuffer& out)
+    {
+        size_t pos = 0;
+        string cmd = nextWord(line,pos);
+        if (cmd.empty()) return;
+        string name = nextWord(line,pos);
+        try {
+            if (name.empty()) throw ParseError(cmd+" needs a name");
+            if (cmd=="set") {
+                while (pos<line.size() && isBlank(line[pos])) ++pos;
+                size_t end = line.size();
+                while (end>pos && isBlank(line[end-1])) --end;
+                set(name,line.substr(pos,end-pos));
+                out.append("ok\n",3);
+            }
+            else if (cmd=="get") {
+                string value = get(name);
+                out.append(name);
+                out.append(" = ",3);
+                out.append(value);
+                out.append('\n');
+            }
+            else if (cmd=="reset") {
+                reset(name);
+                out.append("ok\n",3);
+            }
+            else if (cmd=="reload") {
+                reload(name);
+                out.append("ok\n",3);
+            }
+            else {
+                throw ParseError(string("unknown command ")+cmd);
+            }
+        }
+        catch (exception& e) {
+            out.append("error ",6);
+            out.append(e.what());
+            out.append('\n');
+        }
+    };
+};
+
+}
+#endif /* TUNABLECONTROL_HPP_ */
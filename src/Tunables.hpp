@@ -0,0 +1,121 @@
+/*
+ * Tunables.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef TUNABLES_HPP_
+#define TUNABLES_HPP_
+#include <cstdlib>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <type_traits>
+#include "Allocators.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+namespace putils {
+
+//!
+//! \brief the thread which calls the subscribers of every Tunable, started by the first change
+//!  which has a subscriber. Subscribers are called one at a time in the order of the changes.
+//!
+class TunableNotifier {
+public:
+    static ThreadPool& pool()
+    {
+        static ThreadPool notifier(1);
+        return notifier;
+    };
+
+    //!
+    //! \brief wait until the subscribers of every change made so far have been called
+    //!
+    static void wait()
+    {
+        pool().wait();
+    };
+};
+
+//!
+//! \brief a number or flag changed while the program runs and read from any thread without a lock.
+//!
+//!  The value lives alone in a cache line so that reading it never contends with anything else.
+//!  Readers use load(), a relaxed load, or acquire() when the value publishes data written before
+//!  it was stored. A change is one release store; the subscribers are then called on the
+//!  TunableNotifier thread, never on the thread making the change, and only if the value differs.
+//!
+//!  Bind a Tunable to an option with ProgramOptions::addOption so that every source can set it and
+//!  change it at run time through a TunableControl. T must be an arithmetic type.
+//!
+template<typename T>
+class Tunable {
+    static_assert(is_arithmetic<T>::value,"a Tunable holds an arithmetic type");
+public:
+    explicit Tunable(T initial=T()):cell(),mtx(),subscribers()
+    {
+        cell.value.store(initial,memory_order_relaxed);
+    };
+
+    virtual ~Tunable()
+    {
+    };
+
+    T load() const throw ()
+    {
+        return cell.value.load(memory_order_relaxed);
+    };
+
+    T acquire() const throw ()
+    {
+        return cell.value.load(memory_order_acquire);
+    };
+
+    operator T() const throw ()
+    {
+        return load();
+    };
+
+    //!
+    //! \brief make v the value and queue the subscribers if it changed. Changes are expected from
+    //!  one control thread at a time.
+    //!
+    void store(T v)
+    {
+        if (cell.value.load(memory_order_relaxed)==v) return;
+        cell.value.store(v,memory_order_release);
+        lock_guard<mutex> lock(mtx);
+        if (subscribers.empty()) return;
+        vector< function<void(T)> > calls(subscribers);
+        TunableNotifier::pool().submit([calls,v]() {
+            for (size_t k=0; k<calls.size(); ++k) calls[k](v);
+        });
+    };
+
+    //!
+    //! \brief call f with each later value
+    //!
+    void subscribe(const function<void(T)>& f)
+    {
+        lock_guard<mutex> lock(mtx);
+        subscribers.push_back(f);
+    };
+
+private:
+    Tunable(const Tunable&);
+    Tunable& operator=(const Tunable&);
+
+    struct alignas(PUTILS_CACHE_LINE) cell_t {
+        atomic<T> value;
+    };
+
+    // the subscribers are only touched by changes, keep them off the value's line
+    cell_t cell;
+    mutex mtx;
+    vector< function<void(T)> > subscribers;
+};
+
+}
+#endif /* TUNABLES_HPP_ */
@@ -0,0 +1,101 @@
+
+#define PUTILS_COUNT_ALLOCATIONS
+#include "AllocationCounter.hpp"
+#include <iostream>
+#include <string>
+#include "putils.hpp"
+#include "ProgramOptions.hpp"
+#include <cstdlib>
+
+using namespace std;
+
+//
+// checks the number of heap allocations made by the calls which should make few or none.
+// Exits with EXIT_FAILURE if any single call allocates more than its bound.
+//
+int main()
+{
+    if (!putils::allocationCountingEnabled()) {
+        cerr << "allocation counting hooks are not linked in\n";
+        return EXIT_FAILURE;
+    }
+    {
+        // the aligned allocation calls the allocators use must be counted too
+        putils::AllocationScope scope;
+        void *p = 0;
+        if (posix_memalign(&p,64,100)==0) free(p);
+        free(aligned_alloc(64,128));
+        if (scope.allocations()!=2) {
+            cerr << "aligned allocations are not counted\n";
+            return EXIT_FAILURE;
+        }
+    }
+    const size_t reps = 100000;
+    putils::ProgramOptions options;
+    putils::OptionHandle tolerance_handle = options.addOption("tolerance","solver tolerance","1.e-8");
+    options.addOption("iterations","iteration limit","100");
+    options.addOption("input_file","input data file","/scratch/shared/run/input_data.h5");
+    options.addOption("verbose","verbose output");
+    const string tolerance("tolerance");
+    const string input_file("input_file");
+    const string verbose("verbose");
+
+    putils::checkAllocations("ProgramOptions::hasOption",0,reps,[&]() {
+        volatile bool b = options.hasOption(tolerance);
+        (void)b;
+    });
+    putils::checkAllocations("ProgramOptions::hasValue",0,reps,[&]() {
+        volatile bool b = options.hasValue(verbose);
+        (void)b;
+    });
+    putils::checkAllocations("ProgramOptions::wasSet",0,reps,[&]() {
+        volatile bool b = options.wasSet(tolerance);
+        (void)b;
+    });
+    putils::checkAllocations("ProgramOptions::getValue short",0,reps,[&]() {
+        string v = options.getValue(tolerance);
+    });
+    putils::checkAllocations("ProgramOptions::wasSet handle",0,reps,[&]() {
+        volatile bool b = options.wasSet(tolerance_handle);
+        (void)b;
+    });
+    putils::checkAllocations("ProgramOptions::getValue handle",0,reps,[&]() {
+        string v = options.getValue(tolerance_handle);
+    });
+    // a value longer than the small string buffer costs the copy returned
+    putils::checkAllocations("ProgramOptions::getValue long",1,reps,[&]() {
+        string v = options.getValue(input_file);
+    });
+
+    const string number("3.25e-4");
+    const string integer("123456");
+    putils::checkAllocations("string2type<double>",0,reps,[&]() {
+        volatile double x = putils::string2type<double>(number);
+        (void)x;
+    });
+    putils::checkAllocations("string2type<int>",0,reps,[&]() {
+        volatile int x = putils::string2type<int>(integer);
+        (void)x;
+    });
+    putils::checkAllocations("string2type<bool>",0,reps,[&]() {
+        volatile bool x = putils::string2type<bool>(string("true"));
+        (void)x;
+    });
+
+    string line;
+    for (size_t k=0; k<=reps; ++k) line += "token ";
+    putils::StringTokenizer tokens(line,DEFAULT_DELIMITERS);
+    putils::checkAllocations("StringTokenizer::nextToken",0,reps,[&]() {
+        string t = tokens.nextToken();
+    });
+
+    const char *args[] = { "prog", "-tolerance", "1.e-6", "--iterations=50", "-verbose" };
+    int nargs = sizeof(args)/sizeof(args[0]);
+    putils::checkAllocations("ProgramOptions::parseCommandLine",8,reps/10,[&]() {
+        options.parseCommandLine(nargs,const_cast<char**>(args));
+    });
+
+    size_t failures = putils::allocationCheckFailures();
+    if (failures) cerr << failures << " allocation checks failed\n";
+    return (failures) ? EXIT_FAILURE:EXIT_SUCCESS;
+}
@@ -1,15 +1,1541 @@
-
-
 #include <iostream>
+#include <sstream>
 #include <string>
 #include "ProgramOptions.hpp"
+#include "StreamTokenizer.hpp"
+#include "Allocators.hpp"
+#include "FilePathUtils.h"
+#include "DirectoryWalker.hpp"
+#include "BatchFileReader.hpp"
+#include "LatencyHistogram.hpp"
+#include "SubCommands.hpp"
+#include "ParameterSweep.hpp"
+#include "TunableControl.hpp"
+#include "SharedOptions.hpp"
 #include <fstream>
 #include <cstdlib>
+#include <functional>
+#include <sys/wait.h>
 
 using namespace std;
 
+static int failures = 0;
+
+//
+// count and report a failed check, the program exits with EXIT_FAILURE if any failed
+//
+static void check(bool ok,const string& what)
+{
+    if (!ok) {
+        cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+//
+// true when f, run in a child process with its output discarded, exits with EXIT_FAILURE as
+// ProgramOptions does on errors. The error output is kept in errors when given.
+//
+static bool exitsWithFailure(const function<void()>& f,string *errors=0)
+{
+    cout.flush();
+    cerr.flush();
+    pid_t pid = fork();
+    if (pid==0) {
+        freopen("/dev/null","w",stdout);
+        freopen((errors) ? "child_errors":"/dev/null","w",stderr);
+        f();
+        _exit(EXIT_SUCCESS);
+    }
+    int status = 0;
+    waitpid(pid,&status,0);
+    if (errors) {
+        ifstream in("child_errors");
+        ostringstream text;
+        text << in.rdbuf();
+        *errors = text.str();
+        unlink("child_errors");
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status)==EXIT_FAILURE;
+}
+
+//
+// write text to the file filename
+//
+static void writeFile(const string& filename,const string& text)
+{
+    ofstream f(filename.c_str());
+    f << text;
+}
+
+static void testStreamTokenizer()
+{
+    // a buffer of 8 bytes makes most tokens straddle a refill
+    string text;
+    for (int k=0; k<200; ++k) text += "tok" + putils::type2string(k) + ((k%3) ? " ":"\n\t ");
+    istringstream is(text);
+    putils::StreamTokenizer tokens(is,DEFAULT_DELIMITERS,8);
+    int k = 0;
+    bool in_order = true;
+    while (tokens.hasTokens()) {
+        in_order = in_order && tokens.nextToken()=="tok"+putils::type2string(k);
+        ++k;
+    }
+    check(in_order && k==200,"StreamTokenizer tokens across refills");
+    check(tokens.bytesRead()==text.size(),"StreamTokenizer reads the whole stream");
+
+    istringstream numbers("1 22 333 4444");
+    putils::StreamTokenizer elements(numbers,DEFAULT_DELIMITERS,5);
+    int sum = 0;
+    while (elements.hasTokens()) sum += elements.nextElement<int>();
+    check(sum==4800,"StreamTokenizer nextElement with tokens almost filling the buffer");
+
+    istringstream longer("short waytoolongtoken");
+    putils::StreamTokenizer small(longer,DEFAULT_DELIMITERS,8);
+    small.nextToken();
+    bool thrown = false;
+    try {
+        small.nextToken();
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    check(thrown,"StreamTokenizer rejects a token longer than the buffer");
+
+    {
+        ofstream f("stream_tokens");
+        f << text;
+    }
+    putils::StreamTokenizer from_file(string("stream_tokens"),DEFAULT_DELIMITERS,16);
+    k = 0;
+    while (from_file.hasTokens()) {
+        from_file.nextToken();
+        ++k;
+    }
+    check(k==200,"StreamTokenizer reading a named file");
+    unlink("stream_tokens");
+}
+
+static void testAllocators()
+{
+    void *p = putils::AlignedAllocate(100,256);
+    check(reinterpret_cast<uintptr_t>(p)%256==0,"AlignedAllocate alignment");
+    putils::AlignedFree(p,100);
+    bool thrown = false;
+    try {
+        putils::AlignedAllocate(100,48);
+    }
+    catch (putils::PutilsError&) {
+        thrown = true;
+    }
+    check(thrown,"AlignedAllocate rejects an alignment which is not a power of two");
+
+    void *a = putils::PoolMalloc(40);
+    putils::PoolFree(a,40);
+    void *b = putils::PoolMalloc(48);
+    check(a==b,"PoolMalloc reuses a freed block of the same size class");
+    putils::PoolFree(b,48);
+    char *big = static_cast<char*>(putils::PoolMalloc(5000));
+    memset(big,1,5000);
+    putils::PoolFree(big,5000);
+    vector<int,putils::PoolAllocator<int> > pooled;
+    for (int k=0; k<1000; ++k) pooled.push_back(k);
+    check(pooled[999]==999,"PoolAllocator vector");
+    vector<double,putils::AlignedAllocator<double> > aligned(10,1.0);
+    check(reinterpret_cast<uintptr_t>(aligned.data())%PUTILS_CACHE_LINE==0,"AlignedAllocator vector");
+
+    putils::Arena arena(1024);
+    arena.allocate(3,1);
+    void *q = arena.allocate(64,64);
+    check(reinterpret_cast<uintptr_t>(q)%64==0,"Arena alignment");
+    arena.allocate(4000);
+    check(arena.bytesUsed()==4067 && arena.bytesReserved()>=4067,"Arena grows past its block size");
+    arena.reset();
+    check(arena.bytesUsed()==0 && arena.bytesReserved()==1024,"Arena reset keeps the first block");
+}
+
+static void testFileInfo()
+{
+    {
+        ofstream f("stat_file");
+        f << "0123456789";
+    }
+    putils::FileInfo info("stat_file");
+    check(info.exists() && info.isRegularFile() && !info.isDirectory() && info.size()==10,"FileInfo of a file");
+    check(putils::FileInfo(".").isDirectory(),"FileInfo of a directory");
+    check(!putils::FileInfo("no_such_file").exists(),"FileInfo of a missing file");
+
+    putils::StatCache cache(1,0.);
+    cache.lookup("stat_file");
+    check(cache.lookup("stat_file").size()==10,"StatCache returns the cached record");
+    check(cache.hits()==1 && cache.misses()==1,"StatCache counts a hit and a miss");
+    cache.invalidate();
+    cache.lookup("stat_file");
+    check(cache.misses()==2,"StatCache invalidate makes entries stale");
+    cache.lookup(".");
+    cache.lookup("stat_file");
+    check(cache.misses()==4,"StatCache drops the least recently used entry");
+    unlink("stat_file");
+}
+
+static void testDirectoryWalker()
+{
+    // a tree deeper than the walk needs to find every level, with a link which must not be followed
+    string dir = "walk_tree";
+    system("rm -rf walk_tree");
+    mkdir(dir.c_str(),0755);
+    size_t nfiles = 0;
+    for (int k=0; k<20; ++k) {
+        dir += "/d" + putils::type2string(k);
+        mkdir(dir.c_str(),0755);
+        ofstream(dir+"/a.conf") << k;
+        ofstream(dir+"/b.txt") << k;
+        ++nfiles;
+    }
+    symlink("..","walk_tree/d0/up");
+    for (size_t nthreads=1; nthreads<=4; nthreads+=3) {
+        putils::DirectoryWalker walker;
+        walker.setThreads(nthreads);
+        walker.addSuffix(".conf");
+        vector<putils::DirEntry> entries;
+        walker.walk("walk_tree/",entries);
+        bool ok = entries.size()==nfiles;
+        for (size_t k=0; ok && k<entries.size(); ++k) ok = entries[k].path.compare(0,13,"walk_tree/d0/")==0;
+        check(ok,"DirectoryWalker finds every level with "+putils::type2string(nthreads)+" threads");
+    }
+    vector<putils::DirEntry> links = putils::findFiles("walk_tree","up");
+    check(links.size()==1 && links[0].info.isLink(),"DirectoryWalker reports a link without following it");
+    putils::DirectoryWalker top;
+    top.setRecursive(false);
+    top.setReportDirectories(true);
+    vector<putils::DirEntry> root;
+    top.walk("/",root);
+    bool single_slash = root.size()>0;
+    for (size_t k=0; k<root.size(); ++k) single_slash = single_slash && root[k].path.compare(0,2,"//")!=0;
+    check(single_slash,"DirectoryWalker paths below /");
+    bool thrown = false;
+    try {
+        top.walk("no_such_dir",root);
+    }
+    catch (putils::SystemError&) {
+        thrown = true;
+    }
+    check(thrown,"DirectoryWalker reports a missing root");
+    system("rm -rf walk_tree");
+}
+
+static void testCopyFile()
+{
+    string data;
+    for (int k=0; k<100000; ++k) data += putils::type2string(k) + "\n";
+    {
+        ofstream f("copy_source");
+        f << data;
+    }
+    putils::copyFileToFile("copy_source","copy_target",true);
+    ifstream in("copy_target");
+    stringstream copied;
+    copied << in.rdbuf();
+    check(copied.str()==data,"copyFileToFile copies the contents");
+
+    link("copy_source","copy_alias");
+    string msg;
+    try {
+        putils::copyFileToFile("copy_source","copy_alias");
+    }
+    catch (putils::SystemError& e) {
+        msg = e.what();
+    }
+    check(msg.find("same file")!=string::npos && putils::sizeOfFile("copy_source")==data.size(),
+          "copyFileToFile refuses to copy a file onto itself");
+    msg.clear();
+    try {
+        putils::copyFileToFile("no_such_file","copy_target");
+    }
+    catch (putils::SystemError& e) {
+        msg = e.what();
+    }
+    check(msg.find("open failed")!=string::npos,"copyFileToFile names the failed open");
+    unlink("copy_source");
+    unlink("copy_alias");
+    unlink("copy_target");
+}
+
+//
+// the number of open file descriptors of the process
+//
+static size_t openDescriptors()
+{
+    vector<putils::DirEntry> fds;
+    putils::DirectoryWalker walker;
+    walker.setThreads(1);
+    walker.setRecursive(false);
+    return walker.walk("/proc/self/fd",fds);
+}
+
+static void testBatchFileReader()
+{
+    vector<string> files;
+    for (int k=0; k<8; ++k) {
+        files.push_back("batch_file_" + putils::type2string(k));
+        ofstream(files.back().c_str()) << string(1000*k,'a'+k);
+    }
+    files.push_back("no_such_file");
+    files.push_back(".");
+    for (int uring=0; uring<2; ++uring) {
+        putils::BatchFileReader reader;
+        reader.setUseIoUring(uring);
+        reader.setThreads(3);
+        vector<int> errors(files.size(),-1);
+        vector<string> contents(files.size());
+        mutex mtx;
+        reader.readAll(files,[&](size_t k,int error,const char *data,size_t len) {
+            lock_guard<mutex> lock(mtx);
+            errors[k] = error;
+            contents[k].assign(data,len);
+        });
+        bool ok = true;
+        for (int k=0; k<8; ++k) ok = ok && errors[k]==0 && contents[k]==string(1000*k,'a'+k);
+        string path = (uring) ? " with io_uring if available":" with threads";
+        check(ok,"BatchFileReader contents"+path);
+        check(errors[8]==ENOENT && errors[9]==EINVAL,"BatchFileReader errors"+path);
+
+        // only readable files, so the first callback comes with other reads in flight
+        vector<string> readable(files.begin(),files.begin()+8);
+        size_t before = openDescriptors();
+        bool thrown = false;
+        try {
+            reader.readAll(readable,[](size_t,int,const char*,size_t) {
+                throw putils::PutilsError("stop");
+            });
+        }
+        catch (putils::PutilsError&) {
+            thrown = true;
+        }
+        check(thrown && openDescriptors()==before,"BatchFileReader closes its files when the callback throws"+path);
+    }
+    for (int k=0; k<8; ++k) unlink(files[k].c_str());
+}
+
+static void testLayers()
+{
+    putils::ProgramOptions options;
+    options.addOption("alpha","first","a0");
+    options.addOption("beta","second");
+    options.addOption("gamma","third","g0");
+    writeFile("layer_file","alpha = a1\nbeta = b1\n");
+    const char *args[] = { "prog", "-alpha", "a2" };
+    options.parseCommandLine(3,const_cast<char**>(args));
+    options.parseOptionFile("layer_file");
+    check(options.getValue("alpha")=="a2" && options.sourceOf("alpha")=="command line",
+          "the first source parsed wins");
+    check(options.getValue("beta")=="b1" && options.sourceOf("beta")=="layer_file","a later source fills in");
+    check(options.sourceOf("gamma")=="default" && options.wasSet("gamma")==false,"a default value");
+    options.clearSource("command line");
+    check(options.getValue("alpha")=="a1" && options.sourceOf("alpha")=="layer_file",
+          "clearing a source uncovers the next one");
+    writeFile("layer_file","gamma = g1\n");
+    options.parseOptionFile("layer_file");
+    check(options.getValue("alpha")=="a0" && !options.hasValue("beta") && options.getValue("gamma")=="g1",
+          "parsing a source again replaces its values");
+    options.setValue("beta","b2");
+    options.setValue("beta","b3");
+    check(options.getValue("beta")=="b2" && options.sourceOf("beta")=="user","setValue keeps the first value");
+    const char *again[] = { "prog", "--gamma=g2" };
+    options.parseCommandLine(2,const_cast<char**>(again));
+    check(options.getValue("gamma")=="g2","the command line keeps its place in the order");
+    check(exitsWithFailure([]() {
+        putils::ProgramOptions strict;
+        strict.addOption("alpha","first");
+        writeFile("layer_unknown","delta = 1\n");
+        strict.parseOptionFile("layer_unknown");
+    }),"an unknown option in a file prints the help");
+    unlink("layer_file");
+    unlink("layer_unknown");
+}
+
+static void testLazy()
+{
+    putils::ProgramOptions options;
+    options.setLazy(true);
+    options.addOption("lz_a","first");
+    options.addOption("lz_b","second","b0");
+    int c = 0;
+    options.addOption("lz_c","bound","0",c);
+    writeFile("lazy_file","lz_a = 1\nlz_b = \"two words\"\n\nlz_c = 3\n");
+    options.parseOptionFile("lazy_file");
+    check(c==3,"a bound option is resolved while indexing");
+    check(options.getValue("lz_b")=="two words" && options.sourceOf("lz_a")=="lazy_file",
+          "lazily indexed values are converted when used");
+    setenv("LZT_LZ_A","env",1);
+    setenv("LZT_LZ_B","env",1);
+    options.parseEnvironment("LZT");
+    check(options.getValue("lz_a")=="1","the lazy environment keeps its place in the order");
+    options.validateAll();
+    check(options.getValue("lz_b")=="two words" && c==3,"validateAll with nothing to report");
+
+    check(exitsWithFailure([]() {
+        putils::ProgramOptions lazy;
+        lazy.setLazy(true);
+        lazy.addOption("lz_a","first");
+        writeFile("lazy_unknown","lz_a = 1\nlz_z = 2\n");
+        lazy.parseOptionFile("lazy_unknown");
+        if (lazy.getValue("lz_a")!="1") _exit(EXIT_SUCCESS);
+        lazy.validateAll();
+    }),"validateAll reports an unknown option found while indexing");
+    check(exitsWithFailure([]() {
+        putils::ProgramOptions lazy;
+        lazy.setLazy(true);
+        int count = 0;
+        lazy.addOption("lz_count","bound","1",count);
+        writeFile("lazy_bad","lz_count = many\n");
+        lazy.parseOptionFile("lazy_bad");
+    }),"a bad value for a bound option is reported by the lazy parse");
+    check(exitsWithFailure([]() {
+        // once the file is parsed eagerly the environment's bad value is the one to convert
+        putils::ProgramOptions lazy;
+        lazy.setLazy(true);
+        int count = 0;
+        putils::OptionHandle h = lazy.addOption("lz_count","bound","1",count);
+        lazy.addOption("lz_other","other");
+        writeFile("lazy_bad","lz_count = 5\n");
+        lazy.parseOptionFile("lazy_bad");
+        setenv("LZT_LZ_COUNT","many",1);
+        lazy.parseEnvironment("LZT");
+        lazy.setLazy(false);
+        writeFile("lazy_bad","lz_other = 1\n");
+        lazy.parseOptionFile("lazy_bad");
+        lazy.getValue(h);
+    }),"a bad value uncovered by an eager parse exits through the help");
+    unlink("lazy_file");
+    unlink("lazy_unknown");
+    unlink("lazy_bad");
+}
+
+static void testHandles()
+{
+    putils::ProgramOptions options;
+    putils::OptionHandle a = options.addOption("h_a","first","a0");
+    putils::OptionHandle b = options.addOption("h_b","second");
+    double x = 0;
+    putils::OptionHandle c = options.addOption("h_c","bound","0.5",x);
+    check(options.getHandle("h_b")==b && !(a==b),"getHandle finds the handle addOption returned");
+    check(options.getValue(a)=="a0" && options.hasValue(a) && !options.wasSet(a),"a handle reads the default");
+    check(!options.hasValue(b) && options.getValue(b)=="","a handle to an option without a value");
+    options.setValue(b,"b1");
+    check(options.getValue(b)=="b1" && options.getValue("h_b")=="b1" && options.wasSet(b),
+          "setValue through a handle");
+    const char *args[] = { "prog", "-h_c", "2.5" };
+    options.parseCommandLine(3,const_cast<char**>(args));
+    check(x==2.5 && options.getValue(c)=="2.5","a handle to a bound option");
+    check(exitsWithFailure([a]() {
+        putils::ProgramOptions other;
+        other.addOption("h_a","first","a0");
+        other.getValue(a);
+    }),"a handle from another ProgramOptions is reported");
+    // a bad value a lazy source gives a bound option, uncovered by an eager parse and read through
+    // a handle, exits through the help rather than terminating
+    check(exitsWithFailure([]() {
+        putils::ProgramOptions options;
+        options.setLazy(true);
+        int count = 0;
+        putils::OptionHandle handle = options.addOption("h_count","bound count","1",count);
+        options.addOption("h_other","another option");
+        writeFile("handles_lazy","h_count = 5\n");
+        options.parseOptionFile("handles_lazy");
+        setenv("HANDLES_H_COUNT","many",1);
+        options.parseEnvironment("HANDLES");
+        options.setLazy(false);
+        writeFile("handles_lazy","h_other = 1\n");
+        options.parseOptionFile("handles_lazy");
+        options.getValue(handle);
+    }),"a bad lazy value for a bound option exits through the help");
+    unlink("handles_lazy");
+}
+
+//
+// the name=value pairs the reader gives for text, one per line, or "error <message>"
+//
+template <class Reader>
+static string readStructured(const string& text)
+{
+    string out;
+    try {
+        Reader reader;
+        reader.parse(text.data(),text.size(),[&](const string& key,const string& value) {
+            out += key+"="+value+"\n";
+        });
+    }
+    catch (putils::ParseError& e) {
+        return string("error ")+e.what();
+    }
+    return out;
+}
+
+static void testStructuredReaders()
+{
+    typedef putils::JsonOptionReader J;
+    typedef putils::TomlOptionReader T;
+    check(readStructured<J>("{\"a\": {\"b\": 1, \"c\": \"x y\"}, \"d\": true, \"e\": null}")=="a.b=1\na.c=x y\nd=true\n",
+          "JSON nested members get dotted names");
+    check(readStructured<J>("{\"l\": [1, 2, 3], \"o\": [{\"k\": \"v\"}]}")=="l=1,2,3\no.0.k=v\n",
+          "JSON arrays of scalars and of objects");
+    check(readStructured<J>("{\"s\": \"q\\\"\\\\\\u00e9\\n\"}")=="s=q\"\\\xc3\xa9\n\n","JSON escapes");
+    // strings which cross the 64 byte blocks of the structural index
+    string pad(61,'p');
+    check(readStructured<J>("{\""+pad+"\": \"a\\\"{,}\", \"b\": \"\\\\\"}")==pad+"=a\"{,}\nb=\\\n",
+          "JSON strings across index blocks");
+    check(readStructured<J>("")=="" && readStructured<J>(" {} ")=="","an empty JSON document");
+    check(readStructured<J>("{\"a\": 1,\n  \"b\" 2}").find("error JSON 2:7")==0,
+          "a JSON error names its line and column");
+    check(readStructured<J>("[1]").find("error JSON 1:1")==0,"a JSON document must be an object");
+    check(readStructured<J>("{\"a\": \"open}").find("error JSON")==0,"an unterminated JSON string");
+    check(readStructured<J>("{\"a\": 1} x").find("error JSON 1:10")==0,"text after the JSON object");
+    check(readStructured<J>("{\"a\": -0.5e+3, \"b\": 0, \"c\": 10E2}")=="a=-0.5e+3\nb=0\nc=10E2\n","JSON numbers");
+    check(readStructured<J>("{\"a\": .5}").find("error JSON 1:7 invalid value")==0,"a JSON number needs an integer part");
+    check(readStructured<J>("{\"a\": -.5}").find("error JSON 1:8 invalid number")==0,"a JSON number needs a digit after -");
+    check(readStructured<J>("{\"a\": 01}").find("error JSON 1:8 invalid number")==0,"a JSON number has no leading zero");
+    check(readStructured<J>("{\"a\": 1.}").find("error JSON 1:9 invalid number")==0,"a JSON fraction needs a digit");
+    check(readStructured<J>("{\"a\": 1e}").find("error JSON 1:9 invalid number")==0,"a JSON exponent needs a digit");
+    check(readStructured<J>("{\"a\": 1.5x}").find("error JSON 1:10 invalid number")==0,"text after a JSON number");
+    check(readStructured<J>("{\"a\": \"x\ty\"}").find("error JSON 1:9 control character")==0,
+          "a raw control character in a JSON string");
+    check(readStructured<J>("{\"a\nb\": 1}").find("error JSON 1:4 control character")==0,
+          "a raw line break in a JSON member name");
+
+    check(readStructured<T>("# comment\ntop = 1\n\n[server]\nhost = \"h\" # inline\nport = 8_080\n"
+                            "\"q.k\".x = 'raw\\n'\n")=="top=1\nserver.host=h\nserver.port=8080\nserver.q.k.x=raw\\n\n",
+          "TOML tables, comments, separators and quoted keys");
+    check(readStructured<T>("a = [1, \"two\", 3]\nd = 1979-05-27 07:32:00\nb = false\n")==
+          "a=1,two,3\nd=1979-05-27 07:32:00\nb=false\n","TOML arrays, dates and booleans");
+    check(readStructured<T>("a = 1\nb = 2 3\n").find("error TOML 2:7")==0,"a TOML error names its line and column");
+    check(readStructured<T>("a = {x = 1}\n").find("inline tables")!=string::npos,"TOML inline tables are refused");
+    check(readStructured<T>("[t\n").find("error TOML 1:3")==0,"an unclosed TOML table");
+    check(readStructured<T>("= 1\n").find("expected a key")!=string::npos,"a TOML line without a key");
+
+    putils::ProgramOptions options;
+    options.addOption("server.host","host","localhost");
+    options.addOption("server.port","port");
+    options.addOption("level","level");
+    writeFile("structured.json","{\"server\": {\"port\": 80}}\n");
+    writeFile("structured.toml","level = 2\n[server]\nport = 81\nhost = \"h\"\n");
+    options.parseJsonFile("structured.json");
+    options.parseTomlFile("structured.toml");
+    check(options.getValue("server.port")=="80" && options.sourceOf("server.port")=="structured.json" &&
+          options.getValue("server.host")=="h" && options.getValue("level")=="2",
+          "JSON and TOML files are source layers");
+    check(exitsWithFailure([]() {
+        putils::ProgramOptions bad;
+        bad.addOption("level","level");
+        writeFile("structured_bad.json","{\"level\": }\n");
+        bad.parseJsonFile("structured_bad.json");
+    }),"a JSON syntax error prints the help");
+    check(exitsWithFailure([]() {
+        putils::ProgramOptions bad;
+        bad.addOption("level","level");
+        writeFile("structured_bad.toml","other = 1\n");
+        bad.parseTomlFile("structured_bad.toml");
+    }),"an unknown TOML name prints the help");
+    unlink("structured.json");
+    unlink("structured.toml");
+    unlink("structured_bad.json");
+    unlink("structured_bad.toml");
+}
+
+static void testExportRoundTrip()
+{
+    const char *values[] = { "", "plain", "two words", "#hash", "a=b", "say \"hi\"", "back\\slash", "line\nbreak",
+                             "'single'", "tab\there", "1.5", "true", "$HOME `x`" };
+    const size_t n = sizeof(values)/sizeof(values[0]);
+    putils::ProgramOptions options;
+    for (size_t k=0; k<n; ++k) options.addOption("rt_"+putils::type2string(k),"value");
+    for (size_t k=0; k<n; ++k) options.setValue("rt_"+putils::type2string(k),values[k]);
+    putils::OutputBuffer json, env, file;
+    options.exportOptions(json,putils::ProgramOptions::EXPORT_JSON);
+    options.exportOptions(env,putils::ProgramOptions::EXPORT_ENVIRONMENT,"RT");
+    options.exportOptions(file,putils::ProgramOptions::EXPORT_OPTION_FILE);
+    writeFile("export.json",json.str());
+    writeFile("export.env",env.str());
+    writeFile("export.options",file.str());
+    // a file large enough for the parallel parse, with the values split over its chunks
+    string large;
+    string comment("# padding to reach the size of a parallel parse\n");
+    while (large.size()<size_t(putils::ProgramOptions::PARALLEL_PARSE_SIZE)) {
+        if (large.size()%(1<<19)<comment.size()) large += "#\n"+file.str();
+        large += comment;
+    }
+    writeFile("export_large.options",large);
+
+    putils::ProgramOptions from_json, from_file, from_lazy, from_large;
+    for (size_t k=0; k<n; ++k) {
+        from_json.addOption("rt_"+putils::type2string(k),"value");
+        from_file.addOption("rt_"+putils::type2string(k),"value");
+        from_lazy.addOption("rt_"+putils::type2string(k),"value");
+        from_large.addOption("rt_"+putils::type2string(k),"value");
+    }
+    from_json.parseJsonFile("export.json");
+    from_file.parseOptionFile("export.options");
+    from_lazy.setLazy(true);
+    from_lazy.parseOptionFile("export.options");
+    from_large.setParseThreads(4);
+    from_large.parseOptionFile("export_large.options");
+    // the shell reads the exported variables and prints them separated by NUL bytes
+    string command("sh -c '. ./export.env && printf \"%s\\0\"");
+    for (size_t k=0; k<n; ++k) command += " \"$RT_RT_"+putils::type2string(k)+"\"";
+    command += "'";
+    string from_env;
+    FILE *shell = popen(command.c_str(),"r");
+    if (shell) {
+        char buffer[256];
+        size_t got;
+        while ((got = fread(buffer,1,sizeof(buffer),shell))>0) from_env.append(buffer,got);
+        pclose(shell);
+    }
+    size_t pos = 0;
+    for (size_t k=0; k<n; ++k) {
+        string name("rt_"+putils::type2string(k));
+        check(from_json.getValue(name)==values[k] && from_json.hasValue(name),
+              "a JSON export reads back the value \""+string(values[k])+"\"");
+        check(from_file.getValue(name)==values[k] && from_file.hasValue(name),
+              "an option file export reads back the value \""+string(values[k])+"\"");
+        check(from_lazy.getValue(name)==values[k] && from_large.getValue(name)==values[k],
+              "lazy and parallel parses read back the value \""+string(values[k])+"\"");
+        size_t end = from_env.find('\0',pos);
+        check(end!=string::npos && from_env.compare(pos,end-pos,values[k])==0,
+              "an environment export reads back the value \""+string(values[k])+"\"");
+        pos = (end==string::npos) ? from_env.size():end+1;
+    }
+    unlink("export.json");
+    unlink("export.env");
+    unlink("export.options");
+    unlink("export_large.options");
+}
+
+static void testBinding()
+{
+    putils::ProgramOptions options;
+    double x = 0;
+    string name;
+    int calls = 0;
+    options.addOption("b_x","bound double","1.5",x);
+    options.addOption("b_name","bound string","first",name);
+    options.addOption("b_n","checked setter","1",[&calls](const string& value) {
+        if (value=="bad") throw putils::ParseError(string("bad value"));
+        ++calls;
+    });
+    check(x==1.5 && name=="first" && calls==1,"bound options start with their defaults");
+    const char *args[] = { "prog", "-b_x", "2.5", "-b_name", "second" };
+    options.parseCommandLine(5,const_cast<char**>(args));
+    check(x==2.5 && name=="second","a parse updates bound variables");
+    options.clearSource("command line");
+    check(x==1.5 && name=="first","clearing a source gives bound variables the values uncovered");
+    options.setSourceValue("control","b_n","2");
+    options.setSourceValue("control","b_n","2");
+    check(calls==2,"a setter is only called when the value changes");
+
+    bool thrown = false;
+    try {
+        options.setSourceValue("control","b_n","bad");
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    check(thrown && options.getValue("b_n")=="2" && options.sourceOf("b_n")=="control" && calls==2,
+          "a value the setter refuses leaves the option as it was");
+    options.unsetSourceValue("control","b_n");
+    check(options.getValue("b_n")=="1" && options.sourceOf("b_n")=="default","the refused value was not kept");
+    thrown = false;
+    try {
+        options.setValue("b_n","bad");
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    check(thrown && options.getValue("b_n")=="1" && !options.wasSet("b_n"),"setValue with a refused value");
+    options.setValue("b_n","3");
+    check(options.getValue("b_n")=="3" && calls==4,"setValue works after a refused value");
+}
+
+static void testParallelParse()
+{
+    // an unknown name early in the file and a malformed line in a later chunk
+    string text("p_a = 1\nunknown_name = 2\n");
+    string comment("# padding to reach the size of a parallel parse\n");
+    size_t lines = 2;
+    while (text.size()<size_t(putils::ProgramOptions::PARALLEL_PARSE_SIZE)) {
+        text += comment;
+        ++lines;
+    }
+    text += "p_b = \"open\n";
+    ++lines;
+    writeFile("parallel.options",text);
+    auto parseWith = [](int threads) {
+        return [threads]() {
+            putils::ProgramOptions options;
+            options.addOption("p_a","first");
+            options.addOption("p_b","second");
+            options.setParseThreads(threads);
+            options.parseOptionFile("parallel.options");
+        };
+    };
+    string errors;
+    string serial_errors;
+    check(exitsWithFailure(parseWith(4),&errors),"a malformed line in a parallel parse prints the help");
+    check(errors.find("at line "+putils::type2string(lines))!=string::npos &&
+          errors.find("unknown_name")==string::npos,
+          "a parallel parse reports the malformed line, with its line in the file, before unknown names");
+    check(exitsWithFailure(parseWith(1),&serial_errors) && errors==serial_errors,
+          "a parallel parse reports a malformed line as a serial parse does");
+
+    writeFile("parallel.options",text.substr(0,text.size()-12));
+    check(exitsWithFailure(parseWith(4),&errors) && exitsWithFailure(parseWith(1),&serial_errors) &&
+          errors==serial_errors && errors.find("parallel.options: ProgramOptions could not find the option unknown_name")!=string::npos,
+          "a parallel parse reports an unknown name, with the file, as a serial parse does");
+
+    writeFile("parallel.options",text.substr(0,text.size()-12)+"p_b = 3\np_a = 4\n");
+    putils::ProgramOptions options;
+    options.addOption("p_a","first");
+    options.addOption("p_b","second");
+    options.allowUnusedOptions(true);
+    options.setParseThreads(4);
+    options.parseOptionFile("parallel.options");
+    check(options.getValue("p_a")=="1" && options.getValue("p_b")=="3","a parallel parse keeps the first values");
+    unlink("parallel.options");
+}
+
+//
+// the number of times text occurs in the trace written now
+//
+static size_t traceCount(const string& text)
+{
+    putils::OutputBuffer out;
+    putils::writeChromeTrace(out);
+    size_t n = 0;
+    for (size_t pos = out.str().find(text); pos!=string::npos; pos = out.str().find(text,pos+1)) ++n;
+    return n;
+}
+
+static void testTrace()
+{
+    // the library's regions are recorded without PUTILS_TRACE, which only controls the macro
+    putils::ProgramOptions options;
+    options.addOption("t_a","first");
+    const char *args[] = { "prog", "-t_a", "1" };
+    options.parseCommandLine(3,const_cast<char**>(args));
+    check(traceCount("parseCommandLine")==0,"nothing is recorded while tracing is off");
+    putils::setTracing(true);
+    options.parseCommandLine(3,const_cast<char**>(args));
+    options.parseCommandLine(3,const_cast<char**>(args));
+    check(traceCount("parseCommandLine")==2,"regions are recorded while tracing is on");
+    putils::clearTrace();
+    check(traceCount("parseCommandLine")==0,"clearTrace forgets the events");
+    {
+        putils::TraceScope scope("test::after_clear");
+    }
+    check(traceCount("test::after_clear")==1 && traceCount("\"ph\":\"X\"")==1,"events recorded after clearTrace");
+    // clearing while another thread records must not lose the events recorded afterwards
+    atomic<bool> go(true);
+    thread recorder([&go]() {
+        while (go.load()) {
+            putils::TraceScope scope("test::busy");
+        }
+        putils::TraceScope scope("test::last");
+    });
+    for (int k=0; k<1000; ++k) putils::clearTrace();
+    go.store(false);
+    recorder.join();
+    check(traceCount("test::last")==1,"clearTrace and a recording thread");
+
+    // threads which have ended pass their buffers on, keeping their events
+    size_t nbuffers = 0;
+    for (int k=0; k<200; ++k) {
+        thread brief([]() {
+            putils::TraceScope scope("test::brief");
+        });
+        brief.join();
+        if (k==0) nbuffers = putils::TraceRegistry::instance().buffers.size();
+    }
+    check(putils::TraceRegistry::instance().buffers.size()==nbuffers,"short lived threads reuse the buffers of ended ones");
+    check(traceCount("test::brief")==200,"the events of ended threads are still written");
+    putils::setTracing(false);
+    putils::clearTrace();
+}
+
+static void testLatencyHistogram()
+{
+    typedef putils::LatencyHistogram H;
+    bool exact = true;
+    for (unsigned long long v=0; v<256; ++v) exact = exact && H::bucketLow(H::bucketOf(v))==v && H::bucketHigh(H::bucketOf(v))==v;
+    check(exact,"small times are counted exactly");
+    bool bounded = true;
+    for (unsigned long long v=256; v<(1ULL<<40); v += v/7+1) {
+        size_t b = H::bucketOf(v);
+        bounded = bounded && H::bucketLow(b)<=v && v<=H::bucketHigh(b) &&
+                  H::bucketHigh(b)-H::bucketLow(b)<=H::bucketLow(b)/H::SUB_BUCKETS &&
+                  H::bucketLow(b+1)==H::bucketHigh(b)+1;
+    }
+    check(bounded,"each bucket holds its times to better than 1% and the buckets are contiguous");
+    check(H::bucketOf(~0ULL)==size_t(H::NBUCKETS-1),"the longest times go in the last bucket");
+
+    H h, odd, even;
+    for (unsigned long long v=1; v<=100000; ++v) {
+        h.record(v);
+        ((v&1) ? odd:even).record(v);
+    }
+    check(h.count()==100000 && h.minimum()==1 && h.maximum()==100000 && h.mean()==50000.5,"count, extremes and mean");
+    check(h.percentile(50)>=50000 && h.percentile(50)<=50000+50000/H::SUB_BUCKETS,"the median");
+    check(h.percentile(99.9)>=99900 && h.percentile(99.9)<=99900+99900/H::SUB_BUCKETS && h.percentile(100)==100000,
+          "the upper percentiles");
+    odd.merge(even);
+    bool same = odd.count()==h.count() && odd.minimum()==1 && odd.maximum()==100000;
+    for (size_t b=0; b<size_t(H::NBUCKETS); ++b) same = same && odd.bucketCount(b)==h.bucketCount(b);
+    check(same,"merging histograms adds their counts");
+    ostringstream csv;
+    h.writeCsv(csv);
+    check(csv.str().find("low_ns,high_ns,count,cumulative\n1,1,1,")==0 &&
+          csv.str().find(",1.000000\n")==csv.str().size()-10,"the CSV export");
+    ostringstream text;
+    h.writeText(text);
+    check(text.str().find("count 100000 ")==0 && text.str().find("p99.9")!=string::npos,"the text export");
+    H empty;
+    check(empty.percentile(50)==0 && empty.minimum()==0 && empty.mean()==0.,"an empty histogram");
+
+    putils::LatencyTimer timer;
+    vector<thread> threads;
+    for (int t=0; t<4; ++t) {
+        threads.push_back(thread([&timer,t]() {
+            putils::LatencyRecorder& rec = timer.recorder();
+            for (int k=0; k<1000; ++k) rec.record(1000*(t+1));
+            putils::ScopedLatency scope(rec);
+        }));
+    }
+    for (size_t t=0; t<threads.size(); ++t) threads[t].join();
+    putils::LatencyHistogram all = timer.snapshot();
+    check(all.count()==4004 && all.bucketCount(H::bucketOf(4000))==1000,"per thread recorders are merged");
+}
+
+// what the sub-commands of testSubCommands were given and how many option tables were built
+static string dispatched;
+static int tables_built = 0;
+
+static void addBuildOptions(putils::ProgramOptions& options)
+{
+    ++tables_built;
+    options.addOption("jobs","parallel jobs","1");
+}
+
+static int runBuild(putils::ProgramOptions& global_options,putils::ProgramOptions& options)
+{
+    dispatched = "build level="+global_options.getValue("level")+" verbose="+global_options.getValue("verbose")+
+                 " jobs="+options.getValue("jobs");
+    return 3;
+}
+
+static void addCleanOptions(putils::ProgramOptions& options)
+{
+    ++tables_built;
+    options.addOption("all","remove everything","0");
+}
+
+static int runClean(putils::ProgramOptions& global_options,putils::ProgramOptions& options)
+{
+    dispatched = "clean level="+global_options.getValue("level")+" verbose="+global_options.getValue("verbose")+
+                 " all="+options.getValue("all");
+    return 4;
+}
+
+//
+// run the dispatcher of testSubCommands on the words of line, returning what the command returns
+//
+static int dispatch(const string& line,bool response_files=false)
+{
+    static const putils::SubCommand commands[] = {
+        { "build", "build the targets", addBuildOptions, runBuild },
+        { "clean", "remove the outputs", addCleanOptions, runClean },
+    };
+    vector<string> words;
+    istringstream in(line);
+    string word;
+    while (in >> word) words.push_back(word);
+    vector<char*> argv;
+    for (size_t k=0; k<words.size(); ++k) argv.push_back(const_cast<char*>(words[k].c_str()));
+    putils::ProgramOptions global_options;
+    global_options.addOption("level","log level","0");
+    global_options.addOption("verbose","verbose output","0");
+    global_options.setResponseFiles(response_files);
+    putils::CommandDispatcher dispatcher(commands);
+    dispatched.clear();
+    tables_built = 0;
+    return dispatcher.run(int(argv.size()),argv.data(),global_options);
+}
+
+static void testSubCommands()
+{
+    check(dispatch("prog -level 3 build -jobs 2")==3 && dispatched=="build level=3 verbose=0 jobs=2" &&
+          tables_built==1,"a global option with a separate value");
+    check(dispatch("prog -verbose clean -all")==4 && dispatched=="clean level=0 verbose=1 all=1",
+          "a global flag before the command");
+    check(dispatch("prog --level=5 -verbose build")==3 && dispatched=="build level=5 verbose=1 jobs=1",
+          "global options with '='");
+    check(dispatch("prog build")==3 && dispatched=="build level=0 verbose=0 jobs=1","no global options");
+    check(exitsWithFailure([]() {
+        dispatch("prog -level 3 install");
+    }),"an unknown command prints the usage");
+    check(exitsWithFailure([]() {
+        dispatch("prog -level 3");
+    }),"a missing command prints the usage");
+    check(exitsWithFailure([]() {
+        dispatch("prog help build");
+        _exit(EXIT_SUCCESS);
+    }),"help for a command prints its options");
+    check(exitsWithFailure([]() {
+        dispatch("prog build -level 3");
+    }),"global options after the command are the command's");
+}
+
+static void testParameterSweep()
+{
+    putils::ProgramOptions options;
+    options.addOption("solver","linear solver","{cg, gmres ,bicg}");
+    options.addOption("n","grid size","10:30:10");
+    options.addOption("dt","time step","1e-3:1e-1:log10");
+    options.addOption("start","start time","12:00:00");
+    options.addOption("tags","tags","{}");
+    options.addOption("title","title");
+
+    putils::ParameterSweep none(options,vector<string>());
+    check(none.size()==1 && none.dimensions()==0 && none[0].getValue("start")=="12:00:00" &&
+          none[0].getValue("tags")=="{}","values are not swept unless their option is named");
+
+    vector<string> swept;
+    swept.push_back("solver");
+    swept.push_back("n");
+    swept.push_back("dt");
+    swept.push_back("title");
+    putils::ParameterSweep sweep(options,swept);
+    check(sweep.size()==27 && sweep.dimensions()==3,"the product of a list and two ranges");
+    check(sweep.axis(0).value(0)=="cg" && sweep.axis(0).value(1)=="gmres" && sweep.axis(0).value(2)=="bicg",
+          "a list sweep, trimmed");
+    check(sweep.axis(1).value(0)=="10" && sweep.axis(1).value(1)=="20" && sweep.axis(1).value(2)=="30",
+          "a linear sweep");
+    check(sweep.axis(2).value(0)=="0.001" && sweep.axis(2).value(1)=="0.01" && sweep.axis(2).value(2)=="0.1",
+          "a log10 sweep");
+    // the last axis varies fastest: i = 9*solver+3*n+dt
+    putils::SweepPoint p = sweep.point(9*2+3*0+1);
+    check(p.coordinate(0)==2 && p.coordinate(1)==0 && p.coordinate(2)==1 && p.getValue("solver")=="bicg" &&
+          p.getValue("n")=="10" && p.getValue("dt")=="0.01" && p.getValue("start")=="12:00:00",
+          "point(i) decodes the mixed radix index");
+    check(p.describe()=="solver=bicg n=10 dt=0.01","describing a point");
+    size_t count = 0;
+    bool ordered = true;
+    for (putils::ParameterSweep::iterator it=sweep.begin(); it!=sweep.end(); ++it) {
+        ordered = ordered && (*it).index()==count && (*it).describe()==sweep.point(count).describe();
+        ++count;
+    }
+    check(count==27 && ordered,"iterating gives every point in order");
+
+    putils::ProgramOptions falling;
+    falling.addOption("x","falling","100:1:log10");
+    falling.addOption("y","step down","1:0:-0.25");
+    vector<string> xy;
+    xy.push_back("x");
+    xy.push_back("y");
+    putils::ParameterSweep down(falling,xy);
+    check(down.axis(0).size()==3 && down.axis(0).value(2)=="1" && down.axis(1).size()==5 && down.axis(1).value(4)=="0",
+          "falling ranges");
+
+    bool thrown = false;
+    try {
+        putils::ParameterSweep bad(options,vector<string>(1,"start"));
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    check(thrown,"a named option with a range which cannot reach its end");
+    thrown = false;
+    try {
+        putils::ParameterSweep bad(options,vector<string>(1,"nothing"));
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    check(thrown,"a name which is not an option");
+    // a named option whose value has a ':' or braces but is no list or range is refused
+    const char *malformed[] = { "1e-3:1e-1:lg10", "1:x:2", "1:2", "1:2:3:4", "{a,,b}", "{a,}", "{}",
+                                "0:1e300:1e-300", "1e-300:1e300:log1.0000000000000002", "0:inf:1", "nan:1:1" };
+    for (size_t k=0; k<sizeof(malformed)/sizeof(malformed[0]); ++k) {
+        putils::ProgramOptions one;
+        one.addOption("m","malformed",malformed[k]);
+        thrown = false;
+        try {
+            putils::ParameterSweep bad(one,vector<string>(1,"m"));
+        }
+        catch (putils::ParseError&) {
+            thrown = true;
+        }
+        check(thrown,string("a malformed sweep ")+malformed[k]);
+    }
+    putils::ProgramOptions plain;
+    plain.addOption("p","plain","abc");
+    plain.addOption("q","braced list","{ x , y }");
+    vector<string> pq;
+    pq.push_back("p");
+    pq.push_back("q");
+    putils::ParameterSweep plain_sweep(plain,pq);
+    check(plain_sweep.dimensions()==1 && plain_sweep.axis(0).size()==2 && plain_sweep.axis(0).value(1)=="y" &&
+          plain_sweep[0].getValue("p")=="abc","a plain value is not swept");
+    thrown = false;
+    try {
+        putils::ParameterSweep bad(options,swept);
+        bad.point(27);
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    check(thrown,"a point out of range");
+}
+
+//
+// the words an ArgumentReader expanding response files gives for the words of line, joined by '|'
+//
+static string readArguments(const string& line)
+{
+    vector<string> words;
+    istringstream in(line);
+    string word;
+    while (in >> word) words.push_back(word);
+    vector<char*> argv;
+    for (size_t k=0; k<words.size(); ++k) argv.push_back(const_cast<char*>(words[k].c_str()));
+    string out;
+    try {
+        putils::ArgumentReader args(int(argv.size()),argv.data());
+        const char *arg;
+        size_t len;
+        while (args.next(arg,len)) {
+            if (out.size()) out += "|";
+            out.append(arg,len);
+        }
+    }
+    catch (putils::ParseError& e) {
+        return string("error ")+e.what();
+    }
+    return out;
+}
+
+static void testResponseFiles()
+{
+    writeFile("outer.rsp","-alpha 'a b' # a comment\n\"-beta\" \"x\\\"y\" @inner.rsp \\\n  last\n");
+    writeFile("inner.rsp","-gamma=1\n");
+    writeFile("cycle_a.rsp","-alpha 1 @cycle_b.rsp\n");
+    writeFile("cycle_b.rsp","@cycle_a.rsp\n");
+    check(readArguments("prog first @outer.rsp @missing.rsp")=="first|-alpha|a b|-beta|x\"y|-gamma=1|last|@missing.rsp",
+          "response files with quotes, comments, continuations and includes");
+    check(readArguments("prog @cycle_a.rsp").find("error response file")==0,"a response file including itself");
+
+    putils::ProgramOptions plain;
+    plain.addOption("alpha","first");
+    const char *args[] = { "prog", "-alpha", "@outer.rsp" };
+    plain.parseCommandLine(3,const_cast<char**>(args));
+    check(plain.getValue("alpha")=="@outer.rsp","response files are not expanded unless asked for");
+    putils::ProgramOptions expanded;
+    expanded.addOption("alpha","first");
+    expanded.addOption("beta","second");
+    expanded.addOption("gamma","third");
+    expanded.setResponseFiles(true);
+    const char *rsp_args[] = { "prog", "@outer.rsp" };
+    writeFile("outer.rsp","-alpha 'a b' # a comment\n\"-beta\" \"x\\\"y\" @inner.rsp\n");
+    expanded.parseCommandLine(2,const_cast<char**>(rsp_args));
+    check(expanded.getValue("alpha")=="a b" && expanded.getValue("beta")=="x\"y" && expanded.getValue("gamma")=="1",
+          "parseCommandLine expands response files");
+
+    writeFile("global.rsp","-level 3 -verbose\n");
+    writeFile("all.rsp","--level=4 build -jobs 5\n");
+    writeFile("jobs.rsp","-jobs 6\n");
+    check(dispatch("prog @global.rsp build @jobs.rsp",true)==3 && dispatched=="build level=3 verbose=1 jobs=6",
+          "the dispatcher expands response files before finding the command");
+    check(dispatch("prog @all.rsp",true)==3 && dispatched=="build level=4 verbose=0 jobs=5",
+          "a command named in a response file");
+    check(exitsWithFailure([]() {
+        dispatch("prog @global.rsp build");
+    }),"the dispatcher leaves @ words alone unless asked to expand them");
+    const char *names[] = { "outer.rsp", "inner.rsp", "cycle_a.rsp", "cycle_b.rsp", "global.rsp", "all.rsp", "jobs.rsp" };
+    for (size_t k=0; k<sizeof(names)/sizeof(names[0]); ++k) unlink(names[k]);
+}
+
+//
+// the replies control gives to the commands in text, served over a pair of pipes
+//
+static string serveCommands(putils::TunableControl& control,const string& text)
+{
+    int in[2], out[2];
+    if (pipe(in) || pipe(out)) return string("pipe failed");
+    if (write(in[1],text.data(),text.size())!=ssize_t(text.size())) return string("write failed");
+    close(in[1]);
+    control.serve(in[0],out[1]);
+    close(in[0]);
+    close(out[1]);
+    string replies;
+    char buf[512];
+    ssize_t n;
+    while ((n = read(out[0],buf,sizeof(buf)))>0) replies.append(buf,n);
+    close(out[0]);
+    return replies;
+}
+
+static void testTunableControl()
+{
+    putils::ProgramOptions options;
+    putils::Tunable<int> threads(1);
+    putils::Tunable<double> ratio(0.);
+    options.addOption("threads","worker threads","2",threads);
+    options.addOption("ratio","a ratio","0.5",ratio);
+    options.addOption("mode","a mode","fast");
+    const char *args[] = { "prog", "-mode", "safe" };
+    options.parseCommandLine(3,const_cast<char**>(args));
+    // made after the command line, so the control comes after it in the order
+    putils::TunableControl control(options);
+    writeFile("tunable_file","threads = 3\n");
+    options.parseOptionFile("tunable_file");
+    check(threads.load()==3,"a bound Tunable takes the file's value");
+
+    check(serveCommands(control,"get threads\nset threads 8\nget threads\n")=="threads = 3\nok\nthreads = 8\n" &&
+          threads.load()==8 && options.sourceOf("threads")=="control","set takes precedence over a later source");
+    check(serveCommands(control,"set threads many\n").find("error bad value many for threads")==0 &&
+          threads.load()==8 && options.getValue("threads")=="8","a bad value is refused and the option kept");
+    check(serveCommands(control,"set mode slow\n")=="error mode is given by command line, which takes precedence over control\n" &&
+          options.getValue("mode")=="safe" && !control.get("mode").empty(),"a value hidden by an earlier source is refused");
+    string kept;
+    check(!options.getSourceValue("control","mode",kept),"a refused value is not kept in the control");
+    check(serveCommands(control,"reset threads\nget threads\n")=="ok\nthreads = 3\n" && threads.load()==3,
+          "reset returns to the other sources");
+    check(serveCommands(control,"reset nothing\nset nothing 1\nget nothing\n")==
+          "error no option named nothing\nerror no option named nothing\nerror no option named nothing\n",
+          "unknown names are errors");
+
+    writeFile("tunable_file","threads = 5\nratio = 0.25\n");
+    check(serveCommands(control,"reload tunable_file\n")=="ok\n" && threads.load()==5 && ratio.load()==0.25,
+          "reload changes the options");
+    writeFile("tunable_file","ratio = 0.75\nthreads = lots\n");
+    check(serveCommands(control,"reload tunable_file\n").find("error")==0 && threads.load()==5 && ratio.load()==0.25 &&
+          options.getValue("ratio")=="0.25","a reload with a bad value changes nothing");
+    writeFile("tunable_file","threads = 6\nunknown = 1\n");
+    check(serveCommands(control,"reload tunable_file\n").find("could not find the option unknown")!=string::npos &&
+          threads.load()==5,"a reload with an unknown name is an error, not an exit");
+    writeFile("tunable_file","threads = \"open\n");
+    check(serveCommands(control,"reload tunable_file\nreload no_such_file\n").find("error")==0 && threads.load()==5,
+          "malformed and missing files are errors");
+    check(serveCommands(control,"bogus x\nget\n")=="error unknown command bogus\nerror get needs a name\n",
+          "malformed commands");
+    unlink("tunable_file");
+}
+
+//
+// the change sets a subscriber was given, one line each of name=value or name unset entries
+//
+struct ChangeLog {
+    mutex mtx;
+    vector<string> sets;
+    bool other_thread;
+
+    ChangeLog():mtx(),sets(),other_thread(true) {};
+
+    putils::OptionChangeCallback callback()
+    {
+        thread::id caller = this_thread::get_id();
+        return [this,caller](const putils::OptionChangeSet& changes) {
+            string line;
+            for (size_t j=0; j<changes.size(); ++j) {
+                if (j) line += " ";
+                line += changes[j].name+((changes[j].has_value) ? "="+changes[j].value:string(" unset"));
+            }
+            lock_guard<mutex> lock(mtx);
+            sets.push_back(line);
+            if (this_thread::get_id()==caller) other_thread = false;
+        };
+    };
+
+    string all()
+    {
+        lock_guard<mutex> lock(mtx);
+        string s;
+        for (size_t k=0; k<sets.size(); ++k) s += sets[k]+"\n";
+        return s;
+    };
+};
+
+static void testSubscribers()
+{
+    putils::ProgramOptions options;
+    options.addOption("s_a","first","0");
+    options.addOption("s_b","second");
+    options.addOption("net.port","port","80");
+    options.addOption("s_bound","bound","1",[](const string& value) {
+        if (value=="bad") throw putils::ParseError(string("bad value"));
+    });
+    ChangeLog ab, net, all_bound;
+    size_t id_ab = options.subscribe(vector<string>({ "s_a", "s_b" }),ab.callback());
+    options.subscribePrefix("net.",net.callback());
+    options.subscribe("s_bound",all_bound.callback());
+
+    const char *args[] = { "prog", "-s_a", "1", "-s_b", "2", "-net.port", "81" };
+    options.parseCommandLine(7,const_cast<char**>(args));
+    options.waitForNotifications();
+    check(ab.all()=="s_a=1 s_b=2\n" && net.all()=="net.port=81\n","one set per parse with the changed options");
+    options.parseCommandLine(7,const_cast<char**>(args));
+    options.waitForNotifications();
+    check(ab.all()=="s_a=1 s_b=2\n","parsing the same values again notifies nobody");
+
+    // values hidden by the command line change nothing until it is cleared
+    options.setSourceValue("control","s_a","5");
+    options.setSourceValue("control","s_b","6");
+    options.setSourceValue("later","s_b","7");
+    options.waitForNotifications();
+    check(ab.all()=="s_a=1 s_b=2\n","hidden values notify nobody");
+    options.clearSource("command line");
+    options.waitForNotifications();
+    check(ab.all()=="s_a=1 s_b=2\ns_a=5 s_b=6\n","clearing a source gives the values it uncovers as one set");
+    options.beginChanges();
+    options.setSourceValue("control","s_a","11");
+    options.beginChanges();
+    options.setSourceValue("control","s_a","12");
+    options.endChanges();
+    options.waitForNotifications();
+    check(ab.all()=="s_a=1 s_b=2\ns_a=5 s_b=6\n","nested batches hold the changes back");
+    options.setSourceValue("control","s_b","13");
+    options.endChanges();
+    options.waitForNotifications();
+    check(ab.all()=="s_a=1 s_b=2\ns_a=5 s_b=6\ns_a=12 s_b=13\n","a batch is one set holding the final values");
+    options.unsetSourceValue("control","s_b");
+    options.unsetSourceValue("later","s_b");
+    options.waitForNotifications();
+    check(ab.all()=="s_a=1 s_b=2\ns_a=5 s_b=6\ns_a=12 s_b=13\ns_b=7\ns_b unset\n","an option losing its value");
+
+    options.addOption("net.host","host","localhost");
+    options.setValue("net.host","example");
+    options.waitForNotifications();
+    check(net.all()=="net.port=81\nnet.port=80\nnet.host=example\n","a prefix subscription covers options added later");
+
+    bool thrown = false;
+    try {
+        options.setSourceValue("control","s_bound","bad");
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    options.waitForNotifications();
+    check(thrown && all_bound.all()=="","a refused value notifies nobody");
+
+    options.unsubscribe(id_ab);
+    options.setSourceValue("control","s_a","9");
+    options.waitForNotifications();
+    check(ab.all()=="s_a=1 s_b=2\ns_a=5 s_b=6\ns_a=12 s_b=13\ns_b=7\ns_b unset\n" && ab.other_thread && net.other_thread,
+          "unsubscribe stops the sets, which come on another thread");
+
+    options.subscribe("s_a",[](const putils::OptionChangeSet&) {
+        throw putils::ParseError(string("subscriber failed"));
+    });
+    options.setSourceValue("control","s_a","10");
+    thrown = false;
+    try {
+        options.waitForNotifications();
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    check(thrown,"waitForNotifications rethrows a subscriber's exception");
+}
+
+static void testSharedOptions()
+{
+    putils::ProgramOptions options;
+    for (int k=0; k<100; ++k) options.addOption("sh"+putils::type2string(k),"shared","v"+putils::type2string(k));
+    options.addOption("sh_unset","no value");
+    putils::SharedOptionPublisher publisher;
+    publisher.publish(options);
+
+    // a forked child reads the values in place and sees a republish
+    int ready[2];
+    int go[2];
+    if (pipe(ready)==-1 || pipe(go)==-1) {
+        check(false,"pipes for the shared options child");
+        return;
+    }
+    cout.flush();
+    cerr.flush();
+    pid_t pid = fork();
+    if (pid==0) {
+        bool ok = true;
+        try {
+            putils::SharedOptionView view(publisher.descriptor());
+            ok = view.size()==100 && view.getValue("sh7")=="v7" && !view.hasValue("sh_unset") && view.generation()==1;
+            char ch = 0;
+            ok = ok && write(ready[1],&ch,1)==1 && read(go[0],&ch,1)==1;
+            ok = ok && view.republished() && view.refresh() && view.getValue("sh7")=="changed" && view.generation()==2;
+        }
+        catch (exception&) {
+            ok = false;
+        }
+        _exit((ok) ? EXIT_SUCCESS:EXIT_FAILURE);
+    }
+    char ch = 0;
+    bool synced = read(ready[0],&ch,1)==1;
+    options.setValue("sh7","changed");
+    publisher.publish(options);
+    synced = synced && write(go[1],&ch,1)==1;
+    int status = 0;
+    waitpid(pid,&status,0);
+    check(synced && WIFEXITED(status) && WEXITSTATUS(status)==EXIT_SUCCESS,"a forked child reads the published options and a republish");
+    close(ready[0]);
+    close(ready[1]);
+    close(go[0]);
+    close(go[1]);
+
+    // the segment does not grow with the number of publishes
+    putils::SharedOptionView view(publisher.descriptor());
+    string text;
+    for (int k=0; k<1000; ++k) {
+        text += "x";
+        if (k%100==0) text = "y";
+        options.setSourceValue("control","sh3",text);
+        publisher.publish(options);
+    }
+    struct stat st;
+    fstat(publisher.descriptor(),&st);
+    check(st.st_size<64*1024,"the segment stays bounded over many publishes");
+    check(view.getValue("sh3")==text && view.generation()==1002,"a view reads the newest table once its own was overwritten");
+    check(view.nameAt(view.size())==0 && string(view.nameAt(0))=="sh0","nameAt stops at the end");
+
+    // a damaged header throws rather than reading past the segment
+    uint64_t seq = 0;
+    pread(publisher.descriptor(),&seq,sizeof(seq),offsetof(putils::SharedOptionHeader,sequence));
+    uint64_t huge = uint64_t(1)<<40;
+    seq += 2;
+    pwrite(publisher.descriptor(),&huge,sizeof(huge),offsetof(putils::SharedOptionHeader,table_size));
+    pwrite(publisher.descriptor(),&seq,sizeof(seq),offsetof(putils::SharedOptionHeader,sequence));
+    bool thrown = false;
+    try {
+        view.refresh();
+    }
+    catch (putils::ParseError&) {
+        thrown = true;
+    }
+    check(thrown,"a table past the end of the segment is refused");
+
+    // a damaged entry is not followed
+    putils::ProgramOptions one;
+    one.addOption("only","one","1");
+    putils::SharedOptionPublisher small;
+    small.publish(one);
+    putils::SharedOptionView small_view(small.descriptor());
+    uint64_t offset = 0;
+    pread(small.descriptor(),&offset,sizeof(offset),offsetof(putils::SharedOptionHeader,table_offset));
+    check(small_view.getValue("only")=="1","the value before the entry is damaged");
+    pwrite(small.descriptor(),&huge,sizeof(huge),offset+sizeof(putils::SharedOptionTable)+offsetof(putils::SharedOptionEntry,value_offset));
+    check(!small_view.hasValue("only") && small_view.value("only")==0 && small_view.valueAt(0)==0,"an entry pointing outside its table is not used");
+
+    // a publish which cannot grow the segment throws and leaves the publisher usable
+    putils::SharedOptionPublisher sealed;
+    sealed.publish(one);
+    sealed.publish(one);
+    putils::SharedOptionView sealed_view(sealed.descriptor());
+    fcntl(sealed.descriptor(),F_ADD_SEALS,F_SEAL_GROW);
+    one.setSourceValue("control","only",string(10000,'x'));
+    thrown = false;
+    try {
+        sealed.publish(one);
+    }
+    catch (putils::SystemError&) {
+        thrown = true;
+    }
+    one.setSourceValue("control","only","3");
+    bool republished = false;
+    try {
+        sealed.publish(one);
+        republished = sealed_view.refresh() && sealed_view.getValue("only")=="3";
+    }
+    catch (exception&) {
+    }
+    check(thrown && republished,"a failed publish keeps the segment for the next one");
+    one.unsetSourceValue("control","only");
+
+    // a new publisher under the same name leaves attached readers their segment
+    string name = "/putils_test_"+putils::type2string(getpid());
+    putils::SharedOptionPublisher first(name);
+    first.publish(one);
+    putils::SharedOptionView old_view(name);
+    one.setValue("only","2");
+    putils::SharedOptionPublisher second(name);
+    second.publish(one);
+    putils::SharedOptionView new_view(name);
+    check(old_view.getValue("only")=="1" && !old_view.refresh() && new_view.getValue("only")=="2",
+          "a segment in use is replaced, not truncated");
+    second.unlink();
+}
+
+static void testFingerprint()
+{
+    // published MurmurHash3 x64 128 vectors, seed 0
+    string fox = "The quick brown fox jumps over the lazy dog";
+    check(putils::Fingerprint::of("",0)==putils::Fingerprint(0,0),"the hash of nothing");
+    check(putils::Fingerprint::of("hello",5)==putils::Fingerprint(0xcbd8a7b341bd9b02ULL,0x5b1e906a48ae1d19ULL),"the hash of hello");
+    check(putils::Fingerprint::of(fox.data(),fox.size())==putils::Fingerprint(0xe34bbc7bbc071b6cULL,0x7a433ca9c49a9347ULL),
+          "the hash of a text longer than a block");
+    check(putils::Fingerprint(0xcbd8a7b341bd9b02ULL,0x5b1e906a48ae1d19ULL).str()=="5b1e906a48ae1d19cbd8a7b341bd9b02","str gives the high half first");
+
+    putils::Fingerprint carry(~0ULL,1);
+    carry += putils::Fingerprint(1,0);
+    check(carry==putils::Fingerprint(0,2),"adding carries into the high half");
+    carry -= putils::Fingerprint(1,0);
+    check(carry==putils::Fingerprint(~0ULL,1),"subtracting borrows from the high half");
+
+    // the order options are added and given in does not matter
+    putils::ProgramOptions a;
+    a.addOption("f_x","x","1");
+    a.addOption("f_y","y");
+    a.addOption("f_z","z","3");
+    putils::ProgramOptions b;
+    b.addOption("f_z","z","3");
+    b.addOption("f_y","y");
+    b.addOption("f_x","x","1");
+    a.setSourceValue("control","f_y","2");
+    a.setSourceValue("control","f_x","5");
+    b.setSourceValue("control","f_x","5");
+    b.setSourceValue("control","f_y","2");
+    check(a.fingerprint()==b.fingerprint(),"the fingerprint does not depend on order");
+    b.setSourceValue("control","f_z","4");
+    check(a.fingerprint()!=b.fingerprint(),"a different value gives a different fingerprint");
+
+    // setting a value and unsetting it again restores the fingerprint
+    putils::Fingerprint before = a.fingerprint();
+    a.setSourceValue("later","f_y","7");
+    a.setSourceValue("control","f_z","8");
+    check(a.fingerprint()!=before,"setting values changes the fingerprint");
+    a.unsetSourceValue("control","f_z");
+    a.unsetSourceValue("later","f_y");
+    check(a.fingerprint()==before,"unsetting them restores it");
+    a.unsetSourceValue("control","f_y");
+    a.setSourceValue("control","f_y","2");
+    check(a.fingerprint()==before,"an option losing and regaining its value");
+
+    // bound options hash the canonical text of their type, and say nothing doing it
+    ostringstream errors;
+    streambuf *saved = cerr.rdbuf(errors.rdbuf());
+    double d1 = 0.;
+    double d2 = 0.;
+    int n1 = 0;
+    int n2 = 0;
+    putils::ProgramOptions c;
+    c.addOption("f_ratio","ratio","0.5",d1);
+    c.addOption("f_count","count","+12",n1);
+    c.addOption("f_name","name","abc");
+    putils::ProgramOptions d;
+    d.addOption("f_ratio","ratio","5e-1",d2);
+    d.addOption("f_count","count","12",n2);
+    d.addOption("f_name","name","abc");
+    bool same = c.fingerprint()==d.fingerprint();
+    d.setSourceValue("control","f_ratio","0.50000000000000011");
+    bool close = c.fingerprint()!=d.fingerprint();
+    cerr.rdbuf(saved);
+    check(same,"values of a bound type fingerprint in canonical form");
+    check(close,"close doubles fingerprint apart");
+    check(errors.str()=="","fingerprinting writes nothing to cerr");
+}
+
+//
+// the options forEachOption finds in text, as name=value@line; with <none> for a missing value and
+// error@line; for a malformed line
+//
+static string tokenize(const string& text)
+{
+    string out;
+    putils::OptionTokenizer::forEachOption(text.data(),text.size(),
+        [&out](const putils::OptionToken& name,const putils::OptionToken& value,size_t line) {
+            out += putils::OptionTokenizer::text(name)+"=";
+            out += (value.present()) ? putils::OptionTokenizer::text(value):string("<none>");
+            out += "@"+putils::type2string(line)+";";
+        },
+        [&out](const char *,size_t line) {
+            out += "error@"+putils::type2string(line)+";";
+        });
+    return out;
+}
+
+static void testOptionTokenizer()
+{
+    check(tokenize("a 1\nb=2\n\n\nc = 3\n")=="a=1@1;b=2@2;c=3@5;","blank lines are skipped and counted");
+    check(tokenize("a\nb 1\r\nc\t2\nd")=="a=<none>@1;b=1@2;c=2@3;d=<none>@4;","names without values, CR LF and tabs");
+    check(tokenize("a \"x y\" z\nb 'p\\nq'\nc \"p\\nq\\t\\\"r\\\\\"\n")=="a=x y@1;b=p\\nq@2;c=p\nq\t\"r\\@3;",
+          "double quotes take escapes, single quotes are literal, text after a value is ignored");
+    check(tokenize("a \"\"\nb ''\n")=="a=@1;b=@2;","empty quoted values");
+    check(tokenize("a 1 # note\nb #note\nc x#y\n# whole\n! bang\n[section]\nd 4")=="a=1@1;b=<none>@2;c=x#y@3;d=4@7;",
+          "comment lines and a # starting a word, not one inside it");
+    check(tokenize("a \"x # y\"\nb '#'\n")=="a=x # y@1;b=#@2;","a # in quotes is text");
+    check(tokenize("a long\\\nvalue\nb \"multi\\\nline\"\nc\\\nd 5\ne \\\n  6\nf 7")=="a=longvalue@1;b=multiline@3;cd=5@5;e=6@7;f=7@9;",
+          "a backslash ending a line continues it and lines are counted past it");
+    check(tokenize("a x\\y\n# c \\\nb 2")=="a=x\\y@1;b=2@3;","a backslash inside a word is kept, a comment is not continued");
+    check(tokenize("a \"open\nb 2\nc 'open\nd 3\ne \"end")=="error@1;b=2@2;error@3;d=3@4;error@5;",
+          "unterminated quotes are reported at their line and the next line is read");
+    check(tokenize("= 1\nb 2")=="error@1;b=2@2;","a line without a name");
+
+    bool thrown = false;
+    try {
+        string text = "a 1\n\nb \"open\n";
+        putils::OptionTokenizer::forEachOption(text.data(),text.size(),
+            [](const putils::OptionToken&,const putils::OptionToken&,size_t) {});
+    }
+    catch (putils::ParseError& e) {
+        thrown = string(e.what()).find("at line 3")!=string::npos;
+    }
+    check(thrown,"without an error callback a malformed line throws with its number");
+
+    string text = "a 1\\\nb 2\nc 3\n";
+    check(putils::OptionTokenizer::isLineStart(text.data(),0) && !putils::OptionTokenizer::isLineStart(text.data(),5) &&
+          putils::OptionTokenizer::isLineStart(text.data(),9) && !putils::OptionTokenizer::isLineStart(text.data(),10),
+          "a continued line break is no place to split");
+
+    // the same syntax through an option file
+    putils::ProgramOptions options;
+    options.addOption("t_a","a");
+    options.addOption("t_b","b");
+    options.addOption("t_c","c");
+    options.addOption("t_d","d");
+    writeFile("tokenizer_file","# settings\n\nt_a = \"two words\" # why\nt_b \"open\nt_c x\\\ny\nt_d\n");
+    string errors;
+    check(exitsWithFailure([&options]() { options.parseOptionFile("tokenizer_file"); },&errors) &&
+          errors.find("line 4")!=string::npos,"parseOptionFile reports the line of an unterminated quote");
+    writeFile("tokenizer_file","# settings\n\nt_a = \"two words\" # why\nt_b 'it''s'\nt_c x\\\ny\nt_d\n");
+    options.loadOptionFile("tokenizer_file");
+    check(options.getValue("t_a")=="two words" && options.getValue("t_b")=="it" && options.getValue("t_c")=="xy" &&
+          options.getValue("t_d")=="true","an option file with quotes, comments and continuations");
+    unlink("tokenizer_file");
+}
+
 int main(int argc,char **argv)
 {
+    testStreamTokenizer();
+    testAllocators();
+    testFileInfo();
+    testDirectoryWalker();
+    testCopyFile();
+    testBatchFileReader();
+    testLayers();
+    testLazy();
+    testHandles();
+    testStructuredReaders();
+    testExportRoundTrip();
+    testBinding();
+    testParallelParse();
+    testTrace();
+    testLatencyHistogram();
+    testSubCommands();
+    testParameterSweep();
+    testResponseFiles();
+    testTunableControl();
+    testSubscribers();
+    testSharedOptions();
+    testFingerprint();
+    testOptionTokenizer();
+
     putils::ProgramOptions options;
     const char *var_key = "PAT_VAL4";
     const char *var_val = "abc"; 
@@ -38,5 +1564,6 @@ int main(int argc,char **argv)
     options.parseEnvironment("PAT");
     
     cout << options << "\n";
-    return EXIT_SUCCESS;   
-}
\ No newline at end of file
+    if (failures) cerr << failures << " checks failed\n";
+    return (failures) ? EXIT_FAILURE:EXIT_SUCCESS;   
+}